@@ -0,0 +1,91 @@
+#include "adaptive_execution.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <execution>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const size_t CALIBRATION_SAMPLE_SIZE = 1 << 14;
+const int CALIBRATION_RUNS = 3;
+const size_t MIN_PARALLEL_POSTINGS_LOWER = 1 << 10;
+const size_t MIN_PARALLEL_POSTINGS_UPPER = 1 << 24;
+
+std::once_flag calibration_flag;
+std::atomic<size_t> min_parallel_postings{ 0 };
+std::atomic<size_t> min_batch_queries{ 0 };
+
+void StoreThresholds(const ExecutionThresholds& thresholds) {
+    min_parallel_postings.store(thresholds.min_parallel_postings, std::memory_order_relaxed);
+    min_batch_queries.store(thresholds.min_batch_queries, std::memory_order_relaxed);
+}
+
+//Лучшее из нескольких измерений, в наносекундах.
+template <typename Function>
+double MeasureNanoseconds(Function function) {
+    double best = std::numeric_limits<double>::max();
+    for (int run = 0; run < CALIBRATION_RUNS; ++run) {
+        const auto start = std::chrono::steady_clock::now();
+        function();
+        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+}
+
+ExecutionThresholds CalibrateExecutionThresholds() {
+    const size_t thread_count = std::thread::hardware_concurrency();
+    if (thread_count <= 1) {
+        return { std::numeric_limits<size_t>::max(), std::numeric_limits<size_t>::max() };
+    }
+
+    //Цена документа - накопление релевантности в std::map, как в последовательном поиске.
+    std::vector<int> document_ids(CALIBRATION_SAMPLE_SIZE);
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        document_ids[i] = static_cast<int>(i * 7919 % CALIBRATION_SAMPLE_SIZE);
+    }
+    const double per_posting = MeasureNanoseconds([&document_ids] {
+        std::map<int, double> document_to_relevance;
+        for (const int document_id : document_ids) {
+            document_to_relevance[document_id] += 1.0;
+        }
+    }) / CALIBRATION_SAMPLE_SIZE;
+
+    //Накладные расходы - пустой параллельный проход по задаче на поток.
+    std::vector<int> tasks(thread_count);
+    const double parallel_overhead = MeasureNanoseconds([&tasks] {
+        std::for_each(std::execution::par, tasks.begin(), tasks.end(), [](int& task) {
+            ++task;
+        });
+    });
+
+    //Параллельный запуск окупается, когда сэкономленное время больше его накладных расходов.
+    const double saved_fraction = 1.0 - 1.0 / thread_count;
+    const double break_even = parallel_overhead / std::max(per_posting * saved_fraction, 1e-3);
+    const size_t postings = static_cast<size_t>(std::min<double>(break_even, MIN_PARALLEL_POSTINGS_UPPER));
+    return { std::clamp(postings, MIN_PARALLEL_POSTINGS_LOWER, MIN_PARALLEL_POSTINGS_UPPER), thread_count };
+}
+
+void WarmUpExecutionThresholds() {
+    std::call_once(calibration_flag, [] {
+        StoreThresholds(CalibrateExecutionThresholds());
+    });
+}
+
+ExecutionThresholds GetExecutionThresholds() {
+    WarmUpExecutionThresholds();
+    return { min_parallel_postings.load(std::memory_order_relaxed), min_batch_queries.load(std::memory_order_relaxed) };
+}
+
+void SetExecutionThresholds(const ExecutionThresholds& thresholds) {
+    std::call_once(calibration_flag, [] {});
+    StoreThresholds(thresholds);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+
+//Политика выполнения, при которой сервер сам выбирает между последовательным
+//и параллельным поиском по размеру списков документов слов запроса.
+struct AdaptiveExecutionPolicy {};
+
+inline constexpr AdaptiveExecutionPolicy adaptive_execution{};
+
+struct ExecutionThresholds {
+    size_t min_parallel_postings; //С такого числа документов в списках слов запрос ищется параллельно.
+    size_t min_batch_queries;     //С такого числа запросов пакет параллелится между запросами, а не внутри них.
+};
+
+//Измеряет пороги микробенчмарком, если они ещё не измерены и не заданы.
+//Вызывается конструктором SearchServer, чтобы замер не попадал в первый запрос;
+//можно вызвать и раньше, например при старте процесса.
+void WarmUpExecutionThresholds();
+
+//Пороги, измеренные WarmUpExecutionThresholds. Если замера ещё не было, он выполняется здесь.
+ExecutionThresholds GetExecutionThresholds();
+
+//Заменяет измеренные пороги, например для воспроизводимых замеров.
+void SetExecutionThresholds(const ExecutionThresholds& thresholds);
+
+//Сравнивает цену документа в последовательном накоплении с накладными
+//расходами запуска параллельного алгоритма на этой машине.
+ExecutionThresholds CalibrateExecutionThresholds();
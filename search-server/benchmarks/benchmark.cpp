@@ -0,0 +1,407 @@
+//Замеры производительности поискового сервера, отдельная программа рядом с main.cpp.
+//Сборка из каталога search-server:
+//    g++ -std=c++17 -O2 -I. benchmarks/benchmark.cpp $(ls *.cpp | grep -v main.cpp) -o benchmark -ltbb -lpthread
+//Запуск: ./benchmark [замер ...], без аргументов - все замеры по очереди.
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document_filters.h"
+#include "log_duration.h"
+#include "numa_execution.h"
+#include "process_queries.h"
+#include "search_server.h"
+#include "stop_word_set.h"
+
+using namespace std::string_literals;
+
+namespace {
+
+std::string GenerateWord(std::mt19937& generator, int max_length) {
+    const int length = std::uniform_int_distribution(1, max_length)(generator);
+    std::string word;
+    word.reserve(length);
+    for (int i = 0; i < length; ++i) {
+        word.push_back(std::uniform_int_distribution(static_cast<int>('a'), static_cast<int>('z'))(generator));
+    }
+    return word;
+}
+
+std::vector<std::string> GenerateDictionary(std::mt19937& generator, int word_count, int max_length) {
+    std::vector<std::string> words;
+    words.reserve(word_count);
+    for (int i = 0; i < word_count; ++i) {
+        words.push_back(GenerateWord(generator, max_length));
+    }
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+    return words;
+}
+
+std::string GenerateQuery(std::mt19937& generator, const std::vector<std::string>& dictionary, int word_count, double minus_prob = 0) {
+    std::string query;
+    for (int i = 0; i < word_count; ++i) {
+        if (!query.empty()) {
+            query.push_back(' ');
+        }
+        if (std::uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
+            query.push_back('-');
+        }
+        query += dictionary[std::uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
+    }
+    return query;
+}
+
+std::vector<std::string> GenerateQueries(std::mt19937& generator, const std::vector<std::string>& dictionary, int query_count, int max_word_count) {
+    std::vector<std::string> queries;
+    queries.reserve(query_count);
+    for (int i = 0; i < query_count; ++i) {
+        queries.push_back(GenerateQuery(generator, dictionary, max_word_count));
+    }
+    return queries;
+}
+
+//Документы со случайными словами, статусами и рейтингом от -10 до 10.
+void AddRandomDocuments(SearchServer& search_server, std::mt19937& generator, const std::vector<std::string>& dictionary,
+    int document_count, int word_count) {
+    for (int id = 0; id < document_count; ++id) {
+        const auto status = static_cast<DocumentStatus>(std::uniform_int_distribution<int>(0, DOCUMENT_STATUS_COUNT - 1)(generator));
+        const int rating = std::uniform_int_distribution(-10, 10)(generator);
+        search_server.AddDocument(id, GenerateQuery(generator, dictionary, word_count), status, { rating });
+    }
+}
+
+template <typename KeyMapper>
+void BenchmarkFilter(const std::string& name, const SearchServer& search_server, const std::vector<std::string>& queries, KeyMapper keymapper) {
+    size_t found = 0;
+    {
+        LOG_DURATION(name);
+        for (const std::string& query : queries) {
+            found += search_server.FindTopDocuments(std::execution::seq, query, keymapper).size();
+        }
+    }
+    std::cerr << "  found: "s << found << std::endl;
+}
+
+//Типовые фильтры document_filters.h против той же проверки произвольной лямбдой.
+void BenchmarkFilters() {
+    std::mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 2'000, 10);
+    SearchServer search_server(dictionary[0]);
+    AddRandomDocuments(search_server, generator, dictionary, 20'000, 70);
+    const auto queries = GenerateQueries(generator, dictionary, 1'000, 7);
+
+    BenchmarkFilter("AnyDocument"s, search_server, queries, AnyDocument{});
+    BenchmarkFilter("any lambda"s, search_server, queries, [](int, DocumentStatus, int) { return true; });
+    BenchmarkFilter("StatusIs"s, search_server, queries, StatusIs{ DocumentStatus::ACTUAL });
+    BenchmarkFilter("status lambda"s, search_server, queries, [](int, DocumentStatus status, int) { return status == DocumentStatus::ACTUAL; });
+    BenchmarkFilter("RatingBetween"s, search_server, queries, RatingBetween{ -3, 5 });
+    BenchmarkFilter("rating lambda"s, search_server, queries, [](int, DocumentStatus, int rating) { return -3 <= rating && rating <= 5; });
+    BenchmarkFilter("IdModulo{ 2, 0 }"s, search_server, queries, IdModulo{ 2, 0 });
+    BenchmarkFilter("even id lambda"s, search_server, queries, [](int document_id, DocumentStatus, int) { return document_id % 2 == 0; });
+    BenchmarkFilter("IdModulo{ 3, 1 }"s, search_server, queries, IdModulo{ 3, 1 });
+    BenchmarkFilter("id % 3 lambda"s, search_server, queries, [](int document_id, DocumentStatus, int) { return document_id % 3 == 1; });
+}
+
+template <typename ExecutionPolicy>
+void BenchmarkRanking(const std::string& name, const SearchServer& search_server, ExecutionPolicy policy, const std::vector<std::string>& queries) {
+    double total_relevance = 0.0;
+    {
+        LOG_DURATION(name);
+        for (const std::string& query : queries) {
+            for (const Document& document : search_server.FindTopDocuments(policy, query)) {
+                total_relevance += document.relevance;
+            }
+        }
+    }
+    std::cerr << "  total relevance: "s << total_relevance << std::endl;
+}
+
+//TF-IDF и BM25 на одних и тех же запросах.
+void BenchmarkRankingModels() {
+    std::mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 2'000, 10);
+    SearchServer search_server(dictionary[0]);
+    AddRandomDocuments(search_server, generator, dictionary, 20'000, 70);
+    const auto queries = GenerateQueries(generator, dictionary, 1'000, 7);
+
+    for (const RankingModel model : { RankingModel::TF_IDF, RankingModel::BM25 }) {
+        search_server.SetRankingModel(model);
+        const std::string model_name = model == RankingModel::TF_IDF ? "TF-IDF"s : "BM25"s;
+        BenchmarkRanking(model_name + " seq"s, search_server, std::execution::seq, queries);
+        BenchmarkRanking(model_name + " par"s, search_server, std::execution::par, queries);
+    }
+}
+
+//ProcessQueriesJoined на 100 тысячах запросов против склейки результатов
+//ProcessQueries по одному вектору и обхода ProcessQueriesJoinedView.
+void BenchmarkJoinedQueries() {
+    std::mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 5'000, 10);
+    SearchServer search_server(dictionary[0]);
+    AddRandomDocuments(search_server, generator, dictionary, 10'000, 30);
+    const auto queries = GenerateQueries(generator, dictionary, 100'000, 3);
+
+    {
+        size_t total = 0;
+        {
+            LOG_DURATION("ProcessQueries + serial append"s);
+            std::vector<Document> documents;
+            for (std::vector<Document>& query_documents : ProcessQueries(search_server, queries)) {
+                documents.insert(documents.end(), query_documents.begin(), query_documents.end());
+            }
+            total = documents.size();
+        }
+        std::cerr << "  documents: "s << total << std::endl;
+    }
+    {
+        size_t total = 0;
+        {
+            LOG_DURATION("ProcessQueriesJoined"s);
+            total = ProcessQueriesJoined(search_server, queries).size();
+        }
+        std::cerr << "  documents: "s << total << std::endl;
+    }
+    {
+        size_t total = 0;
+        {
+            LOG_DURATION("ProcessQueriesJoinedView"s);
+            for ([[maybe_unused]] const Document& document : ProcessQueriesJoinedView(search_server, queries)) {
+                ++total;
+            }
+        }
+        std::cerr << "  documents: "s << total << std::endl;
+    }
+}
+
+//GetMemoryStats без top_terms рассчитан на частый опрос и не должен
+//зависеть от размера индекса; с top_terms он обходит словарь.
+void BenchmarkMemoryStats() {
+    std::mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 20'000, 10);
+    SearchServer search_server(dictionary[0]);
+    AddRandomDocuments(search_server, generator, dictionary, 50'000, 70);
+
+    size_t total_bytes = 0;
+    {
+        LOG_DURATION("GetMemoryStats() x 10000"s);
+        for (int i = 0; i < 10'000; ++i) {
+            total_bytes += search_server.GetMemoryStats().GetTotalBytes();
+        }
+    }
+    {
+        LOG_DURATION("GetMemoryStats(10) x 100"s);
+        for (int i = 0; i < 100; ++i) {
+            total_bytes += search_server.GetMemoryStats(10).GetTotalBytes();
+        }
+    }
+    std::cerr << "  checksum: "s << total_bytes << '\n' << search_server.GetMemoryStats(10);
+}
+
+template <typename Contains>
+void BenchmarkStopWordProbe(const std::string& name, const std::vector<std::string>& tokens, Contains contains) {
+    size_t stop_words = 0;
+    {
+        LOG_DURATION(name);
+        for (int round = 0; round < 10; ++round) {
+            for (const std::string& token : tokens) {
+                stop_words += contains(token);
+            }
+        }
+    }
+    std::cerr << "  stop words: "s << stop_words << std::endl;
+}
+
+//StopWordSet против std::set<std::string, std::less<>> на списке из 600 слов.
+void BenchmarkStopWords() {
+    std::mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 20'000, 12);
+    std::vector<std::string_view> stop_words;
+    for (size_t i = 0; i < 600; ++i) {
+        stop_words.push_back(dictionary[i * dictionary.size() / 600]);
+    }
+    const std::set<std::string, std::less<>> stop_word_tree(stop_words.begin(), stop_words.end());
+    const StopWordSet stop_word_set(stop_words);
+
+    std::vector<std::string> tokens;
+    for (int i = 0; i < 1'000'000; ++i) {
+        tokens.push_back(dictionary[std::uniform_int_distribution<size_t>(0, dictionary.size() - 1)(generator)]);
+    }
+
+    BenchmarkStopWordProbe("std::set"s, tokens, [&](std::string_view word) { return stop_word_tree.count(word) > 0; });
+    BenchmarkStopWordProbe("StopWordSet"s, tokens, [&](std::string_view word) { return stop_word_set.Contains(word); });
+}
+
+std::vector<std::vector<Document>> RunQueries(const SearchServer& search_server, const std::vector<std::string>& queries) {
+    std::vector<std::vector<Document>> results;
+    results.reserve(queries.size());
+    for (const std::string& query : queries) {
+        results.push_back(search_server.FindTopDocuments(std::execution::seq, query));
+    }
+    return results;
+}
+
+//Проверка холодного яруса на запросах с перекосом: слова запросов выбираются
+//по закону Ципфа. После MovePostingsToDisk память горячих списков не больше
+//resident_bytes, кэш не больше cache_bytes, а результаты те же, что до переноса.
+//Нарушение - исключение std::logic_error.
+void CheckColdTierReplay() {
+    std::mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 5'000, 10);
+    SearchServer search_server(dictionary[0]);
+    AddRandomDocuments(search_server, generator, dictionary, 20'000, 40);
+
+    std::vector<double> weights(dictionary.size());
+    for (size_t rank = 0; rank < weights.size(); ++rank) {
+        weights[rank] = 1.0 / (rank + 1);
+    }
+    std::discrete_distribution<size_t> skewed_word(weights.begin(), weights.end());
+    std::vector<std::string> queries;
+    for (int i = 0; i < 5'000; ++i) {
+        std::string query;
+        for (int word = 0; word < 3; ++word) {
+            query += dictionary[skewed_word(generator)] + ' ';
+        }
+        queries.push_back(std::move(query));
+    }
+
+    search_server.EnableTermReadCounting();
+    std::vector<std::vector<Document>> expected;
+    {
+        LOG_DURATION("replay in memory"s);
+        expected = RunQueries(search_server, queries);
+    }
+
+    //Всё на диске: в памяти остаётся только сам массив списков.
+    const std::string path = (std::filesystem::temp_directory_path() / "search_server_cold_postings.bin").string();
+    const size_t total_bytes = search_server.GetMemoryStats().inverted_index_bytes;
+    search_server.MovePostingsToDisk(path, { 0, 0 });
+    const size_t fixed_bytes = search_server.GetMemoryStats().inverted_index_bytes;
+
+    const PostingTierOptions options{ (total_bytes - fixed_bytes) / 10, (total_bytes - fixed_bytes) / 20 };
+    search_server.MovePostingsToDisk(path, options);
+    std::vector<std::vector<Document>> actual;
+    {
+        LOG_DURATION("replay with cold tier"s);
+        actual = RunQueries(search_server, queries);
+    }
+
+    const size_t resident_bytes = search_server.GetMemoryStats().inverted_index_bytes - fixed_bytes;
+    const ColdPostingStats stats = *search_server.GetColdPostingStats();
+    std::cerr << "resident: "s << resident_bytes << " of "s << options.resident_bytes << " bytes\n"s << stats;
+    if (resident_bytes > options.resident_bytes) {
+        throw std::logic_error("resident postings exceed resident_bytes"s);
+    }
+    if (stats.cached_bytes > options.cache_bytes) {
+        throw std::logic_error("cold posting cache exceeds cache_bytes"s);
+    }
+    for (size_t query = 0; query < queries.size(); ++query) {
+        const bool is_same = expected[query].size() == actual[query].size()
+            && std::equal(expected[query].begin(), expected[query].end(), actual[query].begin(), [](const Document& lhs, const Document& rhs) {
+                return lhs.id == rhs.id && std::abs(lhs.relevance - rhs.relevance) < 1e-9;
+            });
+        if (!is_same) {
+            throw std::logic_error("cold tier changed results of query: "s + queries[query]);
+        }
+    }
+}
+
+//Первые cpu_count процессоров топологии с сохранением деления на узлы.
+std::vector<NumaNode> TakeCpus(const std::vector<NumaNode>& topology, size_t cpu_count) {
+    std::vector<NumaNode> nodes;
+    for (const NumaNode& node : topology) {
+        if (cpu_count == 0) {
+            break;
+        }
+        const size_t taken = std::min(cpu_count, node.cpus.size());
+        nodes.push_back({ node.id, { node.cpus.begin(), node.cpus.begin() + taken } });
+        cpu_count -= taken;
+    }
+    return nodes;
+}
+
+//numa_execution на пулах от одного процессора до всех: шардирование
+//одного запроса и раздача пакета запросов. Порог параллельного поиска
+//на время замера снимается, чтобы шардировался каждый запрос.
+void BenchmarkNumaScaling() {
+    std::mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 1'000, 10);
+    SearchServer search_server(dictionary[0]);
+    AddRandomDocuments(search_server, generator, dictionary, 50'000, 70);
+    const auto queries = GenerateQueries(generator, dictionary, 500, 7);
+
+    const ExecutionThresholds thresholds = GetExecutionThresholds();
+    SetExecutionThresholds({ 0, 0 });
+
+    const std::vector<NumaNode>& topology = GetNumaTopology();
+    size_t cpu_total = 0;
+    for (const NumaNode& node : topology) {
+        cpu_total += node.cpus.size();
+    }
+    std::cerr << topology.size() << " NUMA nodes, "s << cpu_total << " CPUs"s << std::endl;
+
+    for (size_t cpu_count = 1;; cpu_count = std::min(cpu_count * 2, cpu_total)) {
+        PinnedWorkerPool pool(TakeCpus(topology, cpu_count));
+        const NumaExecutionPolicy policy{ &pool };
+        size_t found = 0;
+        {
+            LOG_DURATION("FindTopDocuments, "s + std::to_string(cpu_count) + " CPUs"s);
+            for (const std::string& query : queries) {
+                found += search_server.FindTopDocuments(policy, query).size();
+            }
+        }
+        {
+            LOG_DURATION("ProcessQueries, "s + std::to_string(cpu_count) + " CPUs"s);
+            for (const std::vector<Document>& documents : ProcessQueries(policy, search_server, queries)) {
+                found += documents.size();
+            }
+        }
+        std::cerr << "  found: "s << found << std::endl;
+        if (cpu_count == cpu_total) {
+            break;
+        }
+    }
+    SetExecutionThresholds(thresholds);
+}
+
+struct Benchmark {
+    std::string name;
+    std::function<void()> run;
+};
+
+const std::vector<Benchmark> BENCHMARKS = {
+    { "filters"s, BenchmarkFilters },
+    { "ranking"s, BenchmarkRankingModels },
+    { "joined"s, BenchmarkJoinedQueries },
+    { "memory_stats"s, BenchmarkMemoryStats },
+    { "stop_words"s, BenchmarkStopWords },
+    { "cold_tier"s, CheckColdTierReplay },
+    { "numa_scaling"s, BenchmarkNumaScaling },
+};
+
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> names(argv + 1, argv + argc);
+    for (const Benchmark& benchmark : BENCHMARKS) {
+        if (names.empty() || std::find(names.begin(), names.end(), benchmark.name) != names.end()) {
+            std::cerr << "== "s << benchmark.name << " =="s << std::endl;
+            try {
+                benchmark.run();
+            }
+            catch (const std::exception& error) {
+                std::cerr << benchmark.name << " failed: "s << error.what() << std::endl;
+                return 1;
+            }
+        }
+    }
+}
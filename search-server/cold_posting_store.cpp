@@ -0,0 +1,206 @@
+#include "cold_posting_store.h"
+
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std::string_literals;
+
+#ifdef _WIN32
+
+ColdPostingStore::ColdPostingStore(const std::string& path, size_t cache_bytes)
+    :path_(path)
+    , cache_bytes_(cache_bytes)
+    , file_(std::fopen(path.c_str(), "w+b"))
+{
+    if (file_ == nullptr) {
+        throw std::system_error(errno, std::generic_category(), "cannot open "s + path);
+    }
+}
+
+ColdPostingStore::~ColdPostingStore() {
+    std::fclose(file_);
+    std::remove(path_.c_str());
+}
+
+void ColdPostingStore::ReadAt(uint64_t offset, void* data, size_t size) const {
+    std::lock_guard guard(file_mutex_);
+    if (_fseeki64(file_, static_cast<long long>(offset), SEEK_SET) != 0 || std::fread(data, 1, size, file_) != size) {
+        throw std::runtime_error("cannot read "s + path_);
+    }
+}
+
+#else
+
+ColdPostingStore::ColdPostingStore(const std::string& path, size_t cache_bytes)
+    :path_(path)
+    , cache_bytes_(cache_bytes)
+    , fd_(open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600))
+{
+    if (fd_ < 0) {
+        throw std::system_error(errno, std::generic_category(), "cannot open "s + path);
+    }
+}
+
+ColdPostingStore::~ColdPostingStore() {
+    close(fd_);
+    unlink(path_.c_str());
+}
+
+void ColdPostingStore::ReadAt(uint64_t offset, void* data, size_t size) const {
+    //pread не двигает общую позицию файла, поэтому потоки читают без блокировки.
+    char* bytes = static_cast<char*>(data);
+    while (size > 0) {
+        const ssize_t count = pread(fd_, bytes, size, static_cast<off_t>(offset));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            throw std::system_error(count < 0 ? errno : EIO, std::generic_category(), "cannot read "s + path_);
+        }
+        bytes += count;
+        offset += static_cast<uint64_t>(count);
+        size -= static_cast<size_t>(count);
+    }
+}
+
+#endif
+
+void ColdPostingStore::Write(int term_id, const PostingList& postings) {
+    Entry entry{ file_size_, {} };
+    for (const DocumentStatus status : ALL_DOCUMENT_STATUSES) {
+        const PostingVector& partition = postings.GetPostings(status);
+        entry.partition_sizes[static_cast<size_t>(status)] = static_cast<uint32_t>(partition.size());
+        const size_t bytes = partition.size() * sizeof(Posting);
+        if (bytes == 0) {
+            continue;
+        }
+#ifdef _WIN32
+        std::lock_guard guard(file_mutex_);
+        if (_fseeki64(file_, static_cast<long long>(file_size_), SEEK_SET) != 0 || std::fwrite(partition.data(), 1, bytes, file_) != bytes) {
+            throw std::runtime_error("cannot write "s + path_);
+        }
+#else
+        const char* data = reinterpret_cast<const char*>(partition.data());
+        for (size_t written = 0; written < bytes;) {
+            const ssize_t count = pwrite(fd_, data + written, bytes - written, static_cast<off_t>(file_size_ + written));
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count < 0) {
+                throw std::system_error(errno, std::generic_category(), "cannot write "s + path_);
+            }
+            written += static_cast<size_t>(count);
+        }
+#endif
+        file_size_ += bytes;
+    }
+
+    std::lock_guard guard(mutex_);
+    entries_[term_id] = entry;
+}
+
+size_t ColdPostingStore::GetPartitionSize(int term_id, DocumentStatus status) const {
+    return GetEntry(term_id).partition_sizes[static_cast<size_t>(status)];
+}
+
+std::shared_ptr<const PostingList> ColdPostingStore::Read(int term_id) const {
+    Entry entry;
+    {
+        std::lock_guard guard(mutex_);
+        if (const auto it = cache_index_.find(term_id); it != cache_index_.end()) {
+            cache_.splice(cache_.begin(), cache_, it->second);
+            ++stats_.hits;
+            return it->second->postings;
+        }
+        ++stats_.misses;
+        entry = entries_.at(term_id);
+    }
+
+    //Файл читается без блокировки: другие потоки тем временем обслуживаются из кэша.
+    auto postings = std::make_shared<const PostingList>(Load(entry, nullptr));
+    size_t bytes = 0;
+    for (const uint32_t size : entry.partition_sizes) {
+        bytes += size * sizeof(Posting);
+    }
+
+    std::lock_guard guard(mutex_);
+    stats_.bytes_read += bytes;
+    if (bytes * 4 > cache_bytes_) {
+        ++stats_.rejections;
+        return postings;
+    }
+    if (cache_index_.count(term_id) > 0) {
+        //Тот же список успел прочитать другой поток.
+        return postings;
+    }
+    while (!cache_.empty() && stats_.cached_bytes + bytes > cache_bytes_) {
+        stats_.cached_bytes -= cache_.back().bytes;
+        cache_index_.erase(cache_.back().term_id);
+        cache_.pop_back();
+        ++stats_.evictions;
+    }
+    cache_.push_front({ term_id, postings, bytes });
+    cache_index_.emplace(term_id, cache_.begin());
+    stats_.cached_bytes += bytes;
+    ++stats_.admissions;
+    return postings;
+}
+
+PostingList ColdPostingStore::Take(int term_id, AllocationCounter* counter) {
+    Entry entry;
+    {
+        std::lock_guard guard(mutex_);
+        const auto it = entries_.find(term_id);
+        entry = it->second;
+        entries_.erase(it);
+        if (const auto cached = cache_index_.find(term_id); cached != cache_index_.end()) {
+            stats_.cached_bytes -= cached->second->bytes;
+            cache_.erase(cached->second);
+            cache_index_.erase(cached);
+        }
+    }
+    return Load(entry, counter);
+}
+
+ColdPostingStats ColdPostingStore::GetStats() const {
+    std::lock_guard guard(mutex_);
+    ColdPostingStats stats = stats_;
+    stats.cold_terms = entries_.size();
+    stats.file_bytes = file_size_;
+    return stats;
+}
+
+ColdPostingStore::Entry ColdPostingStore::GetEntry(int term_id) const {
+    std::lock_guard guard(mutex_);
+    return entries_.at(term_id);
+}
+
+PostingList ColdPostingStore::Load(const Entry& entry, AllocationCounter* counter) const {
+    PostingList postings(counter);
+    uint64_t offset = entry.offset;
+    for (const DocumentStatus status : ALL_DOCUMENT_STATUSES) {
+        const size_t size = entry.partition_sizes[static_cast<size_t>(status)];
+        Posting* data = postings.ResizePartition(status, size);
+        if (size > 0) {
+            ReadAt(offset, data, size * sizeof(Posting));
+            offset += size * sizeof(Posting);
+        }
+    }
+    postings.Seal();
+    return postings;
+}
+
+std::ostream& operator<<(std::ostream& out, const ColdPostingStats& stats) {
+    out << "cold terms: "s << stats.cold_terms << ", file: "s << stats.file_bytes << " bytes\n"s
+        << "cache: "s << stats.cached_bytes << " bytes, hits: "s << stats.hits << ", misses: "s << stats.misses << '\n'
+        << "admissions: "s << stats.admissions << ", rejections: "s << stats.rejections
+        << ", evictions: "s << stats.evictions << ", read: "s << stats.bytes_read << " bytes\n"s;
+    return out;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "document.h"
+#include "posting_list.h"
+#include "counting_allocator.h"
+
+struct PostingTierOptions {
+    size_t resident_bytes = 0; //Память под горячие списки, остающиеся в индексе.
+    size_t cache_bytes = 0;    //Память под кэш прочитанных холодных списков.
+};
+
+struct ColdPostingStats {
+    size_t cold_terms = 0;
+    size_t file_bytes = 0;
+    size_t cached_bytes = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t admissions = 0;
+    uint64_t rejections = 0; //Прочитанные списки, не принятые в кэш.
+    uint64_t evictions = 0;
+    uint64_t bytes_read = 0;
+};
+
+std::ostream& operator<<(std::ostream& out, const ColdPostingStats& stats);
+
+//Холодные списки документов в файле. Список читается целиком одним pread
+//и кладётся в кэш прочитанных списков с LRU-вытеснением по объёму.
+//Список больше четверти кэша в кэш не принимается, чтобы редкий запрос
+//по длинному списку не вытеснял всё остальное. Read, Take и GetStats
+//можно вызывать из разных потоков.
+class ColdPostingStore {
+public:
+    //Файл path создаётся заново и удаляется вместе с хранилищем.
+    ColdPostingStore(const std::string& path, size_t cache_bytes);
+
+    ColdPostingStore(const ColdPostingStore&) = delete;
+    ColdPostingStore& operator=(const ColdPostingStore&) = delete;
+
+    ~ColdPostingStore();
+
+    //Дописывает список слова в файл.
+    void Write(int term_id, const PostingList& postings);
+
+    size_t GetPartitionSize(int term_id, DocumentStatus status) const;
+
+    std::shared_ptr<const PostingList> Read(int term_id) const;
+
+    //Забирает список из хранилища, чтобы он снова жил в индексе.
+    //Место в файле не переиспользуется.
+    PostingList Take(int term_id, AllocationCounter* counter);
+
+    ColdPostingStats GetStats() const;
+
+private:
+    struct Entry {
+        uint64_t offset;
+        std::array<uint32_t, DOCUMENT_STATUS_COUNT> partition_sizes;
+    };
+
+    struct CachedList {
+        int term_id;
+        std::shared_ptr<const PostingList> postings;
+        size_t bytes;
+    };
+
+    const std::string path_;
+    const size_t cache_bytes_;
+#ifdef _WIN32
+    std::FILE* file_ = nullptr;
+    mutable std::mutex file_mutex_;
+#else
+    int fd_ = -1;
+#endif
+    uint64_t file_size_ = 0;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<int, Entry> entries_;
+    mutable std::list<CachedList> cache_; //От недавно прочитанных к давним.
+    mutable std::unordered_map<int, std::list<CachedList>::iterator> cache_index_;
+    mutable ColdPostingStats stats_;
+
+    Entry GetEntry(int term_id) const;
+
+    PostingList Load(const Entry& entry, AllocationCounter* counter) const;
+
+    void ReadAt(uint64_t offset, void* data, size_t size) const;
+};
@@ -7,12 +7,16 @@
 
 using namespace std::literals;
 
+inline constexpr size_t CACHE_LINE_SIZE = 64;
+
 template <typename Key, typename Value>
 class ConcurrentMap {
 public:
     static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integer keys"s);
 
-    struct Bucket {
+    //Каждая корзина в своей кэш-линии: потоки, захватывающие соседние
+    //корзины, не перебрасывают друг у друга одну линию с мьютексами.
+    struct alignas(CACHE_LINE_SIZE) Bucket {
         std::map<Key, Value> the_map;
         std::mutex the_mutex;
     };
@@ -39,6 +43,27 @@ public:
         return { key, bucket };
     }
 
+    //Меняет значение, только если ключ уже есть: новых ключей не заводит.
+    template <typename Updater>
+    void UpdateIfPresent(const Key& key, Updater updater) {
+        Bucket& bucket = buckets_[static_cast<uint64_t>(key) % buckets_.size()];
+        std::lock_guard<std::mutex> guard(bucket.the_mutex);
+        if (const auto it = bucket.the_map.find(key); it != bucket.the_map.end()) {
+            updater(it->second);
+        }
+    }
+
+    //Обходит пары без порядка, корзины захватываются по одной.
+    template <typename Callback>
+    void ForEach(Callback callback) {
+        for (Bucket& bucket : buckets_) {
+            std::lock_guard<std::mutex> guard(bucket.the_mutex);
+            for (const auto& [key, value] : bucket.the_map) {
+                callback(key, value);
+            }
+        }
+    }
+
     std::map<Key, Value> BuildOrdinaryMap() {
         std::map<Key, Value> to_return;
         for (Bucket& bucket : buckets_) {
@@ -49,7 +74,9 @@ public:
     }
 
     void erase(const Key& key) {
-        buckets_[static_cast<uint64_t>(key) % buckets_.size()].the_map.erase(key);
+        Bucket& bucket = buckets_[static_cast<uint64_t>(key) % buckets_.size()];
+        std::lock_guard<std::mutex> guard(bucket.the_mutex);
+        bucket.the_map.erase(key);
     }
 
 
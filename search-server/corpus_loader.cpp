@@ -0,0 +1,316 @@
+#include "corpus_loader.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#ifdef _WIN32
+#include <fstream>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std::string_literals;
+using namespace std::string_view_literals;
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path) {
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+        throw std::runtime_error("cannot open "s + path);
+    }
+    buffer_.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+}
+
+MappedFile::~MappedFile() = default;
+
+#else
+
+MappedFile::MappedFile(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "cannot open "s + path);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        const int error = errno;
+        close(fd);
+        throw std::system_error(error, std::generic_category(), "cannot stat "s + path);
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    if (size_ > 0) {
+        void* mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            const int error = errno;
+            close(fd);
+            throw std::system_error(error, std::generic_category(), "cannot map "s + path);
+        }
+        //Файл читается один раз от начала к концу.
+        madvise(mapping, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(mapping);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_ != nullptr) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+#endif
+
+std::string_view MappedFile::GetData() const {
+    return { data_, size_ };
+}
+
+namespace {
+
+const std::string_view DOCUMENT_STATUS_NAMES[DOCUMENT_STATUS_COUNT] = { "ACTUAL"sv, "IRRELEVANT"sv, "BANNED"sv, "REMOVED"sv };
+
+std::string_view CutField(std::string_view& line) {
+    const size_t tab = line.find('\t');
+    if (tab == line.npos) {
+        throw std::invalid_argument("corpus record has too few fields"s);
+    }
+    const std::string_view field = line.substr(0, tab);
+    line.remove_prefix(tab + 1);
+    return field;
+}
+
+int ParseInt(std::string_view text) {
+    int value = 0;
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error != std::errc() || end != text.data() + text.size()) {
+        throw std::invalid_argument("wrong number in corpus record: "s + std::string(text));
+    }
+    return value;
+}
+
+DocumentStatus ParseStatus(std::string_view text) {
+    for (size_t i = 0; i < DOCUMENT_STATUS_COUNT; ++i) {
+        if (text == DOCUMENT_STATUS_NAMES[i]) {
+            return ALL_DOCUMENT_STATUSES[i];
+        }
+    }
+    throw std::invalid_argument("wrong status in corpus record: "s + std::string(text));
+}
+
+std::vector<CorpusRecord> ParseChunk(std::string_view chunk) {
+    std::vector<CorpusRecord> records;
+    while (!chunk.empty()) {
+        const size_t newline = std::min(chunk.find('\n'), chunk.size());
+        const std::string_view line = chunk.substr(0, newline);
+        chunk.remove_prefix(std::min(newline + 1, chunk.size()));
+        if (!line.empty() && line != "\r"sv) {
+            records.push_back(ParseCorpusRecord(line));
+        }
+    }
+    return records;
+}
+
+//Режет данные на куски около chunk_size байт, каждый кончается переводом строки.
+std::vector<std::string_view> SplitIntoChunks(std::string_view data, size_t chunk_size) {
+    std::vector<std::string_view> chunks;
+    while (!data.empty()) {
+        size_t end = data.size();
+        if (chunk_size < data.size()) {
+            const size_t newline = data.find('\n', chunk_size - 1);
+            end = newline == data.npos ? data.size() : newline + 1;
+        }
+        chunks.push_back(data.substr(0, end));
+        data.remove_prefix(end);
+    }
+    return chunks;
+}
+
+//Очередь разобранных кусков. Разборщики берут куски по порядку, но
+//заканчивают в любом; потребитель забирает их строго по порядку.
+//Кусок i лежит в ячейке i % capacity, поэтому в работе не больше capacity кусков.
+class ChunkPipeline {
+public:
+    ChunkPipeline(std::vector<std::string_view> chunks, size_t capacity)
+        :chunks_(std::move(chunks))
+        , slots_(capacity)
+    {
+    }
+
+    void Produce() {
+        while (true) {
+            size_t index;
+            {
+                std::unique_lock lock(mutex_);
+                can_produce_.wait(lock, [this] {
+                    return stopped_ || next_to_parse_ == chunks_.size() || next_to_parse_ < next_to_consume_ + slots_.size();
+                });
+                if (stopped_ || next_to_parse_ == chunks_.size()) {
+                    return;
+                }
+                index = next_to_parse_++;
+            }
+
+            Slot parsed;
+            try {
+                parsed.records = ParseChunk(chunks_[index]);
+            }
+            catch (...) {
+                parsed.error = std::current_exception();
+            }
+            parsed.is_ready = true;
+
+            {
+                std::lock_guard lock(mutex_);
+                slots_[index % slots_.size()] = std::move(parsed);
+            }
+            can_consume_.notify_all();
+        }
+    }
+
+    std::optional<std::vector<CorpusRecord>> Consume() {
+        std::unique_lock lock(mutex_);
+        if (next_to_consume_ == chunks_.size()) {
+            return std::nullopt;
+        }
+        Slot& slot = slots_[next_to_consume_ % slots_.size()];
+        can_consume_.wait(lock, [&slot] {
+            return slot.is_ready;
+        });
+        if (slot.error) {
+            std::rethrow_exception(slot.error);
+        }
+        std::vector<CorpusRecord> records = std::move(slot.records);
+        slot = Slot{};
+        ++next_to_consume_;
+        lock.unlock();
+        can_produce_.notify_all();
+        return records;
+    }
+
+    void Stop() {
+        {
+            std::lock_guard lock(mutex_);
+            stopped_ = true;
+        }
+        can_produce_.notify_all();
+    }
+
+private:
+    struct Slot {
+        std::vector<CorpusRecord> records;
+        std::exception_ptr error;
+        bool is_ready = false;
+    };
+
+    const std::vector<std::string_view> chunks_;
+    std::vector<Slot> slots_;
+    std::mutex mutex_;
+    std::condition_variable can_produce_;
+    std::condition_variable can_consume_;
+    size_t next_to_parse_ = 0;
+    size_t next_to_consume_ = 0;
+    bool stopped_ = false;
+};
+
+}
+
+CorpusRecord ParseCorpusRecord(std::string_view line) {
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+    CorpusRecord record;
+    record.id = ParseInt(CutField(line));
+    record.status = ParseStatus(CutField(line));
+
+    std::string_view ratings = CutField(line);
+    while (true) {
+        ratings.remove_prefix(std::min(ratings.find_first_not_of(' '), ratings.size()));
+        if (ratings.empty()) {
+            break;
+        }
+        const size_t space = std::min(ratings.find(' '), ratings.size());
+        record.ratings.push_back(ParseInt(ratings.substr(0, space)));
+        ratings.remove_prefix(space);
+    }
+
+    record.text = line;
+    return record;
+}
+
+double CorpusLoadStats::GetMegabytesPerSecond() const {
+    return seconds > 0 ? byte_count / (1024.0 * 1024.0) / seconds : 0.0;
+}
+
+std::ostream& operator<<(std::ostream& out, const CorpusLoadStats& stats) {
+    return out << stats.document_count << " documents, "s << stats.byte_count / (1024.0 * 1024.0) << " MB in "s
+        << stats.seconds << " s ("s << stats.GetMegabytesPerSecond() << " MB/s)"s;
+}
+
+CorpusLoadStats LoadCorpus(SearchServer& search_server, const std::string& path, const CorpusLoadOptions& options) {
+    if (options.share_file_buffer) {
+        const auto file = std::make_shared<const MappedFile>(path);
+        return LoadCorpusFromMemory(search_server, file->GetData(), options, file);
+    }
+    const MappedFile file(path);
+    return LoadCorpusFromMemory(search_server, file.GetData(), options);
+}
+
+CorpusLoadStats LoadCorpusFromMemory(SearchServer& search_server, std::string_view data, const CorpusLoadOptions& options, std::shared_ptr<const void> buffer_owner) {
+    const auto start = std::chrono::steady_clock::now();
+
+    const size_t thread_count = options.thread_count > 0 ? options.thread_count : std::max(1u, std::thread::hardware_concurrency());
+    const size_t capacity = options.max_chunks_in_flight > 0 ? options.max_chunks_in_flight : 2 * thread_count;
+    ChunkPipeline pipeline(SplitIntoChunks(data, std::max<size_t>(options.chunk_size, 1)), capacity);
+
+    std::vector<std::thread> workers;
+    workers.reserve(thread_count);
+    auto join_workers = [&workers] {
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    };
+
+    CorpusLoadStats stats;
+    stats.byte_count = data.size();
+    try {
+        //Если поток не удалось создать, уже запущенные останавливаются и ждутся в catch.
+        for (size_t i = 0; i < thread_count; ++i) {
+            workers.emplace_back([&pipeline] {
+                pipeline.Produce();
+            });
+        }
+        while (std::optional<std::vector<CorpusRecord>> records = pipeline.Consume()) {
+            for (const CorpusRecord& record : *records) {
+                if (buffer_owner) {
+                    search_server.AddDocument(record.id, record.text, buffer_owner, record.status, record.ratings);
+                }
+                else {
+                    search_server.AddDocument(record.id, record.text, record.status, record.ratings);
+                }
+                ++stats.document_count;
+            }
+        }
+    }
+    catch (...) {
+        pipeline.Stop();
+        join_workers();
+        throw;
+    }
+    join_workers();
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
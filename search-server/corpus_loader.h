@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+
+//Файл, отображённый в память только для чтения.
+//Без mmap (Windows) содержимое читается в строку целиком.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile();
+
+    std::string_view GetData() const;
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    std::string buffer_;
+#endif
+};
+
+//Запись корпуса - одна строка: id<TAB>статус<TAB>рейтинги через пробел<TAB>текст.
+//Статус - имя: ACTUAL, IRRELEVANT, BANNED или REMOVED.
+struct CorpusRecord {
+    int id;
+    DocumentStatus status;
+    std::vector<int> ratings;
+    std::string_view text; //Указывает в отображённый файл.
+};
+
+CorpusRecord ParseCorpusRecord(std::string_view line);
+
+struct CorpusLoadOptions {
+    size_t thread_count = 0;              //0 - по числу ядер.
+    size_t chunk_size = 4 << 20;          //Примерный размер куска файла в байтах.
+    size_t max_chunks_in_flight = 0;      //0 - вдвое больше потоков.
+    bool share_file_buffer = false;       //Слова ссылаются в отображённый файл, см. AddDocument с buffer_owner.
+};
+
+struct CorpusLoadStats {
+    size_t document_count = 0;
+    size_t byte_count = 0;
+    double seconds = 0.0;
+
+    double GetMegabytesPerSecond() const;
+};
+
+std::ostream& operator<<(std::ostream& out, const CorpusLoadStats& stats);
+
+//Загружает корпус в search_server. Файл режется на куски по границам строк,
+//куски разбираются параллельно, а документы добавляются вызывающим потоком
+//в порядке файла. Разобранных, но не добавленных кусков не больше
+//max_chunks_in_flight, поэтому память не растёт с размером файла.
+//Ошибка разбора или AddDocument останавливает загрузку и пробрасывается.
+CorpusLoadStats LoadCorpus(SearchServer& search_server, const std::string& path, const CorpusLoadOptions& options = {});
+
+//Загрузка корпуса, уже лежащего в памяти. Если задан buffer_owner, data
+//должна лежать в буфере, которым он владеет; документы добавляются без
+//копирования слов.
+CorpusLoadStats LoadCorpusFromMemory(SearchServer& search_server, std::string_view data, const CorpusLoadOptions& options = {}, std::shared_ptr<const void> buffer_owner = nullptr);
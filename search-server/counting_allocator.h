@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+//Сколько байт сейчас выделено через связанные с ним CountingAllocator.
+class AllocationCounter {
+public:
+    void Add(size_t bytes) {
+        bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    void Subtract(size_t bytes) {
+        bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    size_t GetBytes() const {
+        return bytes_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<size_t> bytes_{ 0 };
+};
+
+//Аллокатор поверх std::allocator, ведущий учёт в AllocationCounter:
+//объём контейнеров известен за O(1), без обхода.
+template <typename T>
+class CountingAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    explicit CountingAllocator(AllocationCounter* counter = nullptr) noexcept
+        :counter_(counter)
+    {}
+
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>& other) noexcept
+        :counter_(other.GetCounter())
+    {}
+
+    T* allocate(size_t n) {
+        T* pointer = std::allocator<T>{}.allocate(n);
+        if (counter_ != nullptr) {
+            counter_->Add(n * sizeof(T));
+        }
+        return pointer;
+    }
+
+    void deallocate(T* pointer, size_t n) noexcept {
+        std::allocator<T>{}.deallocate(pointer, n);
+        if (counter_ != nullptr) {
+            counter_->Subtract(n * sizeof(T));
+        }
+    }
+
+    AllocationCounter* GetCounter() const noexcept {
+        return counter_;
+    }
+
+private:
+    AllocationCounter* counter_;
+};
+
+template <typename T, typename U>
+bool operator==(const CountingAllocator<T>& lhs, const CountingAllocator<U>& rhs) noexcept {
+    return lhs.GetCounter() == rhs.GetCounter();
+}
+
+template <typename T, typename U>
+bool operator!=(const CountingAllocator<T>& lhs, const CountingAllocator<U>& rhs) noexcept {
+    return !(lhs == rhs);
+}
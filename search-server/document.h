@@ -1,6 +1,7 @@
 #pragma once
 
 #include<iostream>
+#include<cstddef>
 
 struct Document {
     int id;
@@ -17,6 +18,15 @@ enum class DocumentStatus {
     REMOVED,
 };
 
+const size_t DOCUMENT_STATUS_COUNT = 4;
+
+const DocumentStatus ALL_DOCUMENT_STATUSES[DOCUMENT_STATUS_COUNT] = {
+    DocumentStatus::ACTUAL,
+    DocumentStatus::IRRELEVANT,
+    DocumentStatus::BANNED,
+    DocumentStatus::REMOVED,
+};
+
 std::ostream& operator<<(std::ostream& os, const Document& doc);
 
 void PrintDocument(const Document& document);
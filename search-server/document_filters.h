@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "document.h"
+#include "posting_list.h"
+
+//Типовые фильтры документов для FindTopDocuments. В отличие от произвольной
+//лямбды, их свойства известны на этапе компиляции: StatusIs выбирает раздел
+//списков документов, AnyDocument убирает проверку из цикла совсем,
+//RatingBetween и IdModulo проверяют блок документов циклом без ветвлений
+//(MatchBlock: passes[i] = 1, если block[i] проходит фильтр).
+
+struct AnyDocument {
+    bool operator()(int document_id, DocumentStatus status, int rating) const {
+        return true;
+    }
+};
+
+struct StatusIs {
+    DocumentStatus status;
+
+    bool operator()(int document_id, DocumentStatus document_status, int rating) const {
+        return document_status == status;
+    }
+};
+
+//Рейтинг в диапазоне [min_rating, max_rating].
+struct RatingBetween {
+    int min_rating;
+    int max_rating;
+
+    bool operator()(int document_id, DocumentStatus status, int rating) const {
+        return min_rating <= rating && rating <= max_rating;
+    }
+
+    void MatchBlock(const Posting* block, size_t size, uint8_t* passes) const {
+        //Два сравнения сводятся к одному беззнаковому: rating - min_rating <= max_rating - min_rating.
+        const uint32_t width = static_cast<uint32_t>(max_rating) - static_cast<uint32_t>(min_rating);
+        const uint8_t is_valid = min_rating <= max_rating;
+        for (size_t i = 0; i < size; ++i) {
+            passes[i] = is_valid & static_cast<uint8_t>(static_cast<uint32_t>(block[i].rating) - static_cast<uint32_t>(min_rating) <= width);
+        }
+    }
+};
+
+//id % divisor == remainder, IdModulo{ 2, 0 } - чётные id.
+struct IdModulo {
+    int divisor;
+    int remainder;
+
+    bool operator()(int document_id, DocumentStatus status, int rating) const {
+        return document_id % divisor == remainder;
+    }
+
+    void MatchBlock(const Posting* block, size_t size, uint8_t* passes) const {
+        //id документов неотрицательны, поэтому для степени двойки остаток - это маска.
+        if (divisor > 0 && (divisor & (divisor - 1)) == 0) {
+            const uint32_t mask = static_cast<uint32_t>(divisor - 1);
+            for (size_t i = 0; i < size; ++i) {
+                passes[i] = static_cast<uint8_t>((static_cast<uint32_t>(block[i].document_id) & mask) == static_cast<uint32_t>(remainder));
+            }
+        }
+        else {
+            for (size_t i = 0; i < size; ++i) {
+                passes[i] = static_cast<uint8_t>(block[i].document_id % divisor == remainder);
+            }
+        }
+    }
+};
+
+template <typename Filter>
+struct DocumentFilterTraits {
+    static constexpr bool is_always_true = false;
+    static constexpr bool selects_status = false;
+    static constexpr bool has_block_kernel = false;
+};
+
+template <>
+struct DocumentFilterTraits<AnyDocument> {
+    static constexpr bool is_always_true = true;
+    static constexpr bool selects_status = false;
+    static constexpr bool has_block_kernel = false;
+};
+
+template <>
+struct DocumentFilterTraits<StatusIs> {
+    static constexpr bool is_always_true = false;
+    static constexpr bool selects_status = true;
+    static constexpr bool has_block_kernel = false;
+};
+
+template <>
+struct DocumentFilterTraits<RatingBetween> {
+    static constexpr bool is_always_true = false;
+    static constexpr bool selects_status = false;
+    static constexpr bool has_block_kernel = true;
+};
+
+template <>
+struct DocumentFilterTraits<IdModulo> {
+    static constexpr bool is_always_true = false;
+    static constexpr bool selects_status = false;
+    static constexpr bool has_block_kernel = true;
+};
+
+//DocumentStatus в качестве фильтра превращается в StatusIs.
+template <typename Filter>
+auto MakeDocumentFilter(Filter filter) {
+    if constexpr (std::is_same_v<Filter, DocumentStatus>) {
+        return StatusIs{ filter };
+    }
+    else {
+        return filter;
+    }
+}
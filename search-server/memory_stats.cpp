@@ -0,0 +1,25 @@
+#include "memory_stats.h"
+
+#include <string>
+
+using namespace std::string_literals;
+
+size_t MemoryStats::GetTotalBytes() const {
+    return dictionary_bytes + inverted_index_bytes + forward_index_bytes + document_table_bytes + stop_words_bytes + numa_shard_bytes;
+}
+
+std::ostream& operator<<(std::ostream& out, const MemoryStats& stats) {
+    out << "total: "s << stats.GetTotalBytes() << " bytes\n"s
+        << "dictionary: "s << stats.dictionary_bytes << '\n'
+        << "inverted index: "s << stats.inverted_index_bytes << '\n'
+        << "forward index: "s << stats.forward_index_bytes << '\n'
+        << "document table: "s << stats.document_table_bytes << '\n'
+        << "stop words: "s << stats.stop_words_bytes << '\n'
+        << "numa shards: "s << stats.numa_shard_bytes << '\n'
+        << "terms: "s << stats.term_count << ", postings: "s << stats.posting_count
+        << ", average list: "s << stats.average_posting_list_length << '\n';
+    for (const TermPostingCount& term : stats.largest_terms) {
+        out << term.term << ": "s << term.posting_count << '\n';
+    }
+    return out;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+struct TermPostingCount {
+    std::string_view term;
+    size_t posting_count;
+};
+
+//Память SearchServer по частям, в байтах. Размеры узлов std::map и
+//std::unordered_map оцениваются, списки документов считаются точно.
+//Буферы, переданные в AddDocument с buffer_owner, не учитываются; холодные
+//списки документов и их кэш - тоже, см. SearchServer::GetColdPostingStats.
+struct MemoryStats {
+    size_t dictionary_bytes = 0;
+    size_t inverted_index_bytes = 0;
+    size_t forward_index_bytes = 0;
+    size_t document_table_bytes = 0;
+    size_t stop_words_bytes = 0;
+    size_t numa_shard_bytes = 0; //Копии списков по узлам NUMA, см. numa_execution.
+
+    size_t term_count = 0;
+    size_t posting_count = 0;
+    double average_posting_list_length = 0.0;
+    std::vector<TermPostingCount> largest_terms; //По убыванию числа документов.
+
+    size_t GetTotalBytes() const;
+};
+
+std::ostream& operator<<(std::ostream& out, const MemoryStats& stats);
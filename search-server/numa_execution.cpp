@@ -0,0 +1,241 @@
+#include "numa_execution.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <utility>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace std::string_literals;
+
+namespace {
+
+const std::string NUMA_NODE_DIRECTORY = "/sys/devices/system/node/"s;
+
+//Пул, которому принадлежит текущий поток, - для вложенных вызовов Run.
+thread_local const PinnedWorkerPool* current_worker_pool = nullptr;
+
+//Список вида "0-3,8-11", как в cpulist и online.
+std::vector<int> ParseCpuList(const std::string& text) {
+    std::vector<int> values;
+    size_t position = 0;
+    while (position < text.size()) {
+        const size_t end = std::min(text.find(',', position), text.size());
+        const std::string range = text.substr(position, end - position);
+        position = end + 1;
+        if (range.empty() || range == "\n"s) {
+            continue;
+        }
+        const size_t dash = range.find('-');
+        const int first = std::stoi(range.substr(0, dash));
+        const int last = dash == range.npos ? first : std::stoi(range.substr(dash + 1));
+        for (int value = first; value <= last; ++value) {
+            values.push_back(value);
+        }
+    }
+    return values;
+}
+
+bool ReadLine(const std::string& path, std::string& line) {
+    std::ifstream input(path);
+    return static_cast<bool>(std::getline(input, line));
+}
+
+//Процессоры, на которых процессу разрешено работать.
+std::vector<int> GetAllowedCpus() {
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#endif
+    if (cpus.empty()) {
+        const int cpu_count = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        for (int cpu = 0; cpu < cpu_count; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+void PinCurrentThread(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    //Не удалось закрепить - поток просто работает без привязки.
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+}
+
+std::vector<NumaNode> DetectNumaTopology() {
+    const std::vector<int> allowed_cpus = GetAllowedCpus();
+    std::vector<bool> is_allowed;
+    for (const int cpu : allowed_cpus) {
+        if (static_cast<size_t>(cpu) >= is_allowed.size()) {
+            is_allowed.resize(cpu + 1);
+        }
+        is_allowed[cpu] = true;
+    }
+
+    std::vector<NumaNode> nodes;
+    std::string online;
+    if (ReadLine(NUMA_NODE_DIRECTORY + "online"s, online)) {
+        try {
+            for (const int node_id : ParseCpuList(online)) {
+                std::string cpu_list;
+                if (!ReadLine(NUMA_NODE_DIRECTORY + "node"s + std::to_string(node_id) + "/cpulist"s, cpu_list)) {
+                    continue;
+                }
+                NumaNode node{ node_id, {} };
+                for (const int cpu : ParseCpuList(cpu_list)) {
+                    if (static_cast<size_t>(cpu) < is_allowed.size() && is_allowed[cpu]) {
+                        node.cpus.push_back(cpu);
+                    }
+                }
+                //Узлы без доступных процессоров (только память или чужой cpuset) пропускаем.
+                if (!node.cpus.empty()) {
+                    nodes.push_back(std::move(node));
+                }
+            }
+        }
+        catch (const std::exception&) {
+            nodes.clear();
+        }
+    }
+
+    if (nodes.empty()) {
+        nodes.push_back({ 0, allowed_cpus });
+    }
+    return nodes;
+}
+
+const std::vector<NumaNode>& GetNumaTopology() {
+    static const std::vector<NumaNode> topology = DetectNumaTopology();
+    return topology;
+}
+
+PinnedWorkerPool::PinnedWorkerPool(const std::vector<NumaNode>& nodes) {
+    try {
+        for (const NumaNode& node : nodes) {
+            for (const int cpu : node.cpus) {
+                const size_t worker = worker_nodes_.size();
+                worker_nodes_.push_back(node.id);
+                threads_.emplace_back([this, worker, cpu] {
+                    WorkerLoop(worker, cpu);
+                });
+            }
+        }
+    }
+    catch (...) {
+        //Деструктор не вызовется, уже запущенные потоки останавливаем здесь.
+        Stop();
+        throw;
+    }
+}
+
+PinnedWorkerPool::~PinnedWorkerPool() {
+    Stop();
+}
+
+void PinnedWorkerPool::Stop() {
+    {
+        std::lock_guard guard(mutex_);
+        is_stopping_ = true;
+    }
+    start_condition_.notify_all();
+    for (std::thread& thread : threads_) {
+        thread.join();
+    }
+}
+
+size_t PinnedWorkerPool::GetWorkerCount() const {
+    return worker_nodes_.size();
+}
+
+int PinnedWorkerPool::GetWorkerNode(size_t worker) const {
+    return worker_nodes_[worker];
+}
+
+void PinnedWorkerPool::Run(const std::function<void(size_t worker)>& task) {
+    if (current_worker_pool == this || threads_.empty()) {
+        for (size_t worker = 0; worker < worker_nodes_.size(); ++worker) {
+            task(worker);
+        }
+        return;
+    }
+
+    Round round{ &task, threads_.size(), nullptr };
+    std::unique_lock lock(mutex_);
+    rounds_.push_back({ &round, threads_.size() });
+    start_condition_.notify_all();
+    done_condition_.wait(lock, [&round] {
+        return round.pending == 0;
+    });
+    if (round.error) {
+        std::rethrow_exception(round.error);
+    }
+}
+
+void PinnedWorkerPool::WorkerLoop(size_t worker, int cpu) {
+    PinCurrentThread(cpu);
+    current_worker_pool = this;
+    uint64_t next_round = 0;
+    while (true) {
+        Round* round = nullptr;
+        {
+            std::unique_lock lock(mutex_);
+            start_condition_.wait(lock, [this, next_round] {
+                return is_stopping_ || next_round < first_round_ + rounds_.size();
+            });
+            if (is_stopping_) {
+                return;
+            }
+            QueuedRound& queued = rounds_[next_round - first_round_];
+            round = queued.round;
+            ++next_round;
+            --queued.unstarted;
+            while (!rounds_.empty() && rounds_.front().unstarted == 0) {
+                rounds_.pop_front();
+                ++first_round_;
+            }
+        }
+
+        std::exception_ptr error;
+        try {
+            (*round->task)(worker);
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+
+        std::lock_guard guard(mutex_);
+        if (error && !round->error) {
+            round->error = error;
+        }
+        if (--round->pending == 0) {
+            done_condition_.notify_all();
+        }
+    }
+}
+
+PinnedWorkerPool& GetPinnedWorkerPool() {
+    static PinnedWorkerPool pool(GetNumaTopology());
+    return pool;
+}
+
+PinnedWorkerPool& GetPinnedWorkerPool(NumaExecutionPolicy policy) {
+    return policy.pool != nullptr ? *policy.pool : GetPinnedWorkerPool();
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class PinnedWorkerPool;
+
+//Политика выполнения для многосокетных машин: запрос делится на шарды по id
+//документов, шард обрабатывает один поток пула PinnedWorkerPool, закреплённый
+//за процессором своего узла NUMA. Потоки узла идут в пуле подряд, поэтому
+//узлу достаётся сплошной диапазон id. У каждого потока свой накопитель
+//релевантности, общих изменяемых данных между потоками нет. Если потоки пула
+//на нескольких узлах, SearchServer держит копию списков документов, поделённую
+//по этим диапазонам: шард узла строит поток узла, и запрос читает списки из
+//памяти своего узла. Шарды строятся при первом запросе после изменения индекса
+//и занимают ещё столько же памяти, сколько горячие списки. На одном узле
+//шардов нет, потоки читают общие списки.
+struct NumaExecutionPolicy {
+    PinnedWorkerPool* pool = nullptr; //nullptr - общий пул GetPinnedWorkerPool.
+};
+
+inline constexpr NumaExecutionPolicy numa_execution{};
+
+struct NumaNode {
+    int id;
+    std::vector<int> cpus; //Процессоры узла, доступные процессу.
+};
+
+//Узлы из /sys/devices/system/node. Без NUMA или не на Linux - один узел
+//со всеми доступными процессорами.
+std::vector<NumaNode> DetectNumaTopology();
+
+//Топология определяется при первом обращении.
+const std::vector<NumaNode>& GetNumaTopology();
+
+//Потоки, закреплённые по одному за каждым процессором топологии,
+//в порядке узлов: потоки одного узла идут подряд.
+class PinnedWorkerPool {
+public:
+    explicit PinnedWorkerPool(const std::vector<NumaNode>& nodes);
+
+    PinnedWorkerPool(const PinnedWorkerPool&) = delete;
+    PinnedWorkerPool& operator=(const PinnedWorkerPool&) = delete;
+
+    ~PinnedWorkerPool();
+
+    size_t GetWorkerCount() const;
+
+    int GetWorkerNode(size_t worker) const;
+
+    //Вызывает task(worker) в каждом потоке пула и ждёт всех; исключение первой
+    //упавшей задачи пробрасывается. Вызовы из разных потоков не ждут друг друга:
+    //каждый поток пула берёт раунды в порядке поступления, и пока одни потоки
+    //заканчивают раунд, другие уже выполняют следующий. Вызов из потока самого
+    //пула выполняет task для всех worker на месте, иначе он ждал бы сам себя.
+    void Run(const std::function<void(size_t worker)>& task);
+
+private:
+    struct Round {
+        const std::function<void(size_t)>* task;
+        size_t pending;        //Потоки, ещё не закончившие раунд.
+        std::exception_ptr error;
+    };
+
+    struct QueuedRound {
+        Round* round;
+        size_t unstarted;      //Потоки, ещё не взявшие раунд.
+    };
+
+    std::vector<std::thread> threads_;
+    std::vector<int> worker_nodes_;
+
+    std::mutex mutex_;
+    std::condition_variable start_condition_;
+    std::condition_variable done_condition_;
+    //Раунд уходит из очереди, когда его взяли все потоки. first_round_ - номер rounds_.front().
+    std::deque<QueuedRound> rounds_;
+    uint64_t first_round_ = 0;
+    bool is_stopping_ = false;
+
+    void Stop();
+
+    void WorkerLoop(size_t worker, int cpu);
+};
+
+//Общий пул по GetNumaTopology, создаётся при первом обращении.
+PinnedWorkerPool& GetPinnedWorkerPool();
+
+//Пул политики: policy.pool или общий пул.
+PinnedWorkerPool& GetPinnedWorkerPool(NumaExecutionPolicy policy);
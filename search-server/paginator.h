@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <iterator>
+#include <algorithm>
 #include <stdexcept>
 
 #include "document.h"
@@ -26,19 +27,69 @@ private:
 template <class Iterator>
 std::ostream& operator<<(std::ostream& os, const IteratorRange<Iterator>& docs);
 
+//Страницы не хранятся: итератор страниц вычисляет границы страницы при разыменовании.
 template <typename Iterator>
 class Paginator {
 public:
+    class PageIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = IteratorRange<Iterator>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = IteratorRange<Iterator>;
+
+        PageIterator(Iterator page_begin, Iterator range_end, size_t page_size)
+            :page_begin_(page_begin), range_end_(range_end), page_size_(page_size)
+        {
+        }
+
+        reference operator*() const {
+            return IteratorRange<Iterator>(page_begin_, PageEnd());
+        }
+
+        PageIterator& operator++() {
+            page_begin_ = PageEnd();
+            return *this;
+        }
+
+        PageIterator operator++(int) {
+            PageIterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const PageIterator& other) const {
+            return page_begin_ == other.page_begin_;
+        }
+
+        bool operator!=(const PageIterator& other) const {
+            return page_begin_ != other.page_begin_;
+        }
+
+    private:
+        Iterator page_begin_;
+        Iterator range_end_;
+        size_t page_size_;
+
+        Iterator PageEnd() const {
+            const auto rest = static_cast<size_t>(std::distance(page_begin_, range_end_));
+            return std::next(page_begin_, std::min(rest, page_size_));
+        }
+    };
+
     explicit Paginator(Iterator range_begin, Iterator range_end, size_t page_size);
 
-    auto begin() const;
+    PageIterator begin() const;
 
-    auto end() const;
+    PageIterator end() const;
 
-    size_t size();
+    size_t size() const;
 
 private:
-    std::vector<IteratorRange<Iterator>> pages_;
+    Iterator range_begin_;
+    Iterator range_end_;
+    size_t page_size_;
 };
 
 template <typename Container>
@@ -74,37 +125,27 @@ std::ostream& operator<<(std::ostream& os, const IteratorRange<Iterator>& docs)
 }
 
 template <typename Iterator>
-Paginator<Iterator>::Paginator(Iterator range_begin, Iterator range_end, size_t page_size) {
-
+Paginator<Iterator>::Paginator(Iterator range_begin, Iterator range_end, size_t page_size)
+    : range_begin_(range_begin), range_end_(range_end), page_size_(page_size)
+{
     if (page_size == 0) {
         throw std::invalid_argument("page_size can be zero"s);
     }
-
-    auto r_b = range_begin;
-
-    for (size_t num_of_pages = distance(range_begin, range_end); num_of_pages > 0;) {
-
-        int current_page_size = std::min(num_of_pages, page_size);
-        auto temp_it = r_b + current_page_size;
-        IteratorRange page(r_b, temp_it);
-        pages_.push_back(page);
-        r_b = temp_it;
-        num_of_pages -= current_page_size;
-    }
 }
 
 
 template <typename Iterator>
-auto Paginator<Iterator>::begin() const {
-    return pages_.begin();
+typename Paginator<Iterator>::PageIterator Paginator<Iterator>::begin() const {
+    return PageIterator(range_begin_, range_end_, page_size_);
 }
 
 template <typename Iterator>
-auto Paginator<Iterator>::end() const {
-    return pages_.end();
+typename Paginator<Iterator>::PageIterator Paginator<Iterator>::end() const {
+    return PageIterator(range_end_, range_end_, page_size_);
 }
 
 template <typename Iterator>
-size_t Paginator<Iterator>::size() {
-    return pages_.size();
+size_t Paginator<Iterator>::size() const {
+    const auto range_size = static_cast<size_t>(std::distance(range_begin_, range_end_));
+    return (range_size + page_size_ - 1) / page_size_;
 }
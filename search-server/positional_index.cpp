@@ -0,0 +1,74 @@
+#include "positional_index.h"
+
+#include <algorithm>
+
+namespace {
+void EncodeVarint(uint32_t value, std::vector<uint8_t>& out) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+uint32_t DecodeVarint(const uint8_t*& data) {
+    uint32_t value = 0;
+    for (int shift = 0;; shift += 7) {
+        const uint8_t byte = *data++;
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+}
+}
+
+void EncodePositions(const std::vector<uint32_t>& positions, std::vector<uint8_t>& out) {
+    EncodeVarint(static_cast<uint32_t>(positions.size()), out);
+    uint32_t previous = 0;
+    for (const uint32_t position : positions) {
+        EncodeVarint(position - previous, out);
+        previous = position;
+    }
+}
+
+std::vector<uint32_t> DecodePositions(const uint8_t* data) {
+    const uint32_t count = DecodeVarint(data);
+    std::vector<uint32_t> positions;
+    positions.reserve(count);
+    uint32_t position = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        position += DecodeVarint(data);
+        positions.push_back(position);
+    }
+    return positions;
+}
+
+const uint8_t* SkipPositions(const uint8_t* data) {
+    const uint32_t count = DecodeVarint(data);
+    for (uint32_t i = 0; i < count; ++i) {
+        DecodeVarint(data);
+    }
+    return data;
+}
+
+bool ContainsPhrase(const std::vector<std::pair<std::vector<uint32_t>, uint32_t>>& phrase_positions) {
+    if (phrase_positions.empty()) {
+        return true;
+    }
+    const auto& [first_positions, first_offset] = phrase_positions.front();
+    for (const uint32_t first_position : first_positions) {
+        if (first_position < first_offset) {
+            continue;
+        }
+        const uint32_t start = first_position - first_offset;
+        const bool matched = std::all_of(phrase_positions.begin() + 1, phrase_positions.end(),
+            [start](const auto& word) {
+                return std::binary_search(word.first.begin(), word.first.end(), start + word.second);
+            });
+        if (matched) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+//Позиции слова в документе хранятся так: количество позиций, затем разности
+//соседних позиций, всё в формате varint (7 бит на байт, старший бит - продолжение).
+
+void EncodePositions(const std::vector<uint32_t>& positions, std::vector<uint8_t>& out);
+
+std::vector<uint32_t> DecodePositions(const uint8_t* data);
+
+//Возвращает указатель на байт за концом закодированных позиций.
+const uint8_t* SkipPositions(const uint8_t* data);
+
+//Слова фразы: позиции слова и его смещение от начала фразы.
+//Фраза есть в документе, если для некоторого p каждое слово стоит на p + смещение.
+bool ContainsPhrase(const std::vector<std::pair<std::vector<uint32_t>, uint32_t>>& phrase_positions);
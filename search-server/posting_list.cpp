@@ -0,0 +1,96 @@
+#include "posting_list.h"
+
+#include <algorithm>
+
+namespace {
+bool PostingIdLess(const Posting& posting, int document_id) {
+    return posting.document_id < document_id;
+}
+}
+
+PostingList::PostingList(AllocationCounter* counter) {
+    for (PostingVector& partition : partitions_) {
+        partition = PostingVector(CountingAllocator<Posting>(counter));
+    }
+}
+
+void PostingList::Insert(DocumentStatus status, const Posting& posting) {
+    PostingVector& partition = partitions_[static_cast<size_t>(status)];
+    if (partition.empty() || partition.back().document_id < posting.document_id) {
+        partition.push_back(posting);
+    }
+    else {
+        partition.insert(std::lower_bound(partition.begin(), partition.end(), posting.document_id, PostingIdLess), posting);
+    }
+    ++size_;
+    max_term_count_ = std::max(max_term_count_, posting.term_count);
+    min_document_length_ = std::min(min_document_length_, posting.document_length);
+}
+
+void PostingList::Erase(DocumentStatus status, int document_id) {
+    PostingVector& partition = partitions_[static_cast<size_t>(status)];
+    const auto it = std::lower_bound(partition.begin(), partition.end(), document_id, PostingIdLess);
+    if (it != partition.end() && it->document_id == document_id) {
+        partition.erase(it);
+        --size_;
+    }
+}
+
+const PostingVector& PostingList::GetPostings(DocumentStatus status) const {
+    return partitions_[static_cast<size_t>(status)];
+}
+
+size_t PostingList::size() const {
+    return size_;
+}
+
+bool PostingList::empty() const {
+    return size_ == 0;
+}
+
+uint32_t PostingList::GetMaxTermCount() const {
+    return max_term_count_;
+}
+
+uint32_t PostingList::GetMinDocumentLength() const {
+    return min_document_length_;
+}
+
+Posting* PostingList::ResizePartition(DocumentStatus status, size_t count) {
+    PostingVector& partition = partitions_[static_cast<size_t>(status)];
+    partition.resize(count);
+    partition.shrink_to_fit();
+    return partition.data();
+}
+
+void PostingList::Seal() {
+    size_ = 0;
+    max_term_count_ = 0;
+    min_document_length_ = UINT32_MAX;
+    for (const PostingVector& partition : partitions_) {
+        size_ += partition.size();
+        for (const Posting& posting : partition) {
+            max_term_count_ = std::max(max_term_count_, posting.term_count);
+            min_document_length_ = std::min(min_document_length_, posting.document_length);
+        }
+    }
+}
+
+size_t PostingList::GetMemoryBytes() const {
+    size_t bytes = 0;
+    for (const PostingVector& partition : partitions_) {
+        bytes += partition.capacity() * sizeof(Posting);
+    }
+    return bytes;
+}
+
+void PostingList::Release() {
+    for (PostingVector& partition : partitions_) {
+        PostingVector(partition.get_allocator()).swap(partition);
+    }
+    is_released_ = true;
+}
+
+bool PostingList::IsReleased() const {
+    return is_released_;
+}
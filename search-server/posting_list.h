@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "document.h"
+#include "counting_allocator.h"
+
+struct Posting {
+    int document_id;
+    int rating;
+    uint32_t term_count;
+    uint32_t document_length; //Число не-стоп слов документа.
+};
+
+using PostingVector = std::vector<Posting, CountingAllocator<Posting>>;
+
+//Список документов одного слова, физически разбитый по статусам документов.
+//Внутри статуса документы отсортированы по id.
+class PostingList {
+public:
+    //Память списков учитывается в counter, если он задан.
+    explicit PostingList(AllocationCounter* counter = nullptr);
+
+    void Insert(DocumentStatus status, const Posting& posting);
+
+    void Erase(DocumentStatus status, int document_id);
+
+    const PostingVector& GetPostings(DocumentStatus status) const;
+
+    size_t size() const;
+
+    bool empty() const;
+
+    //Границы для оценки сверху вклада слова: наибольшее число вхождений и
+    //наименьшая длина документа. При удалении не пересчитываются и остаются
+    //верными, хотя и менее точными, оценками.
+    uint32_t GetMaxTermCount() const;
+
+    uint32_t GetMinDocumentLength() const;
+
+    //Массовое заполнение при перестроении индекса: раздел получает ровно count
+    //записей, вызывающий пишет их по указателю по возрастанию id, после
+    //заполнения всех разделов вызывается Seal.
+    Posting* ResizePartition(DocumentStatus status, size_t count);
+
+    //Пересчитывает размер и границы по содержимому разделов.
+    void Seal();
+
+    //Память разделов вместе с запасом вместимости.
+    size_t GetMemoryBytes() const;
+
+    //Освобождает разделы, когда список перенесён в ColdPostingStore.
+    //Размер и границы остаются: по ним запрос оценивает слово, не читая список.
+    void Release();
+
+    bool IsReleased() const;
+
+private:
+    std::array<PostingVector, DOCUMENT_STATUS_COUNT> partitions_;
+    size_t size_ = 0;
+    uint32_t max_term_count_ = 0;
+    uint32_t min_document_length_ = UINT32_MAX;
+    bool is_released_ = false;
+};
@@ -1,42 +1,130 @@
 #include <algorithm>
+#include <atomic>
 #include <execution>
+#include <functional>
 #include <iterator>
+#include <numeric>
 
 #include "process_queries.h"
 
+namespace {
+
+const size_t NUMA_QUERY_BLOCK_SIZE = 16;
+
+}
+
 std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries) {
 	std::vector<std::vector<Document>> result_to_return(queries.size());
 	std::transform(
 		std::execution::par,
 		queries.begin(), queries.end(), //
 		result_to_return.begin(),
-		[&search_server](std::string str) {return search_server.FindTopDocuments(str); }
+		[&search_server](const std::string& str) {return search_server.FindTopDocuments(str); }
 	);
 	return result_to_return;
 }
 
+std::vector<std::vector<Document>> ProcessQueries(AdaptiveExecutionPolicy policy, const SearchServer& search_server, const std::vector<std::string>& queries) {
+	std::vector<std::vector<Document>> result_to_return(queries.size());
+	//Большой пакет параллелим между запросами, малый - внутри тяжёлых запросов.
+	if (queries.size() >= GetExecutionThresholds().min_batch_queries) {
+		std::transform(
+			std::execution::par,
+			queries.begin(), queries.end(), //
+			result_to_return.begin(),
+			[&search_server](const std::string& str) {return search_server.FindTopDocuments(str); }
+		);
+	}
+	else {
+		std::transform(
+			queries.begin(), queries.end(),
+			result_to_return.begin(),
+			[&search_server](const std::string& str) {return search_server.FindTopDocuments(adaptive_execution, str); }
+		);
+	}
+	return result_to_return;
+}
+
+std::vector<std::vector<Document>> ProcessQueries(NumaExecutionPolicy policy, const SearchServer& search_server, const std::vector<std::string>& queries) {
+	std::vector<std::vector<Document>> result_to_return(queries.size());
+	PinnedWorkerPool& pool = GetPinnedWorkerPool(policy);
+	if (pool.GetWorkerCount() <= 1 || queries.size() < GetExecutionThresholds().min_batch_queries) {
+		std::transform(
+			queries.begin(), queries.end(),
+			result_to_return.begin(),
+			[&search_server](const std::string& str) {return search_server.FindTopDocuments(adaptive_execution, str); }
+		);
+		return result_to_return;
+	}
+
+	//Блоки по NUMA_QUERY_BLOCK_SIZE запросов: соседние ячейки результата
+	//пишет один поток, и их кэш-линии не делятся между потоками.
+	std::atomic<size_t> next_block{ 0 };
+	pool.Run([&](size_t) {
+		while (true) {
+			const size_t first = next_block.fetch_add(1, std::memory_order_relaxed) * NUMA_QUERY_BLOCK_SIZE;
+			if (first >= queries.size()) {
+				return;
+			}
+			const size_t last = std::min(first + NUMA_QUERY_BLOCK_SIZE, queries.size());
+			for (size_t query = first; query < last; ++query) {
+				result_to_return[query] = search_server.FindTopDocuments(std::execution::seq, queries[query]);
+			}
+		}
+	});
+	return result_to_return;
+}
+
 std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries) {
-	std::vector<std::vector<Document>> result(queries.size());
-	//std::list<Document> result_to_return;
+	std::vector<std::vector<Document>> result = ProcessQueries(search_server, queries);
 
-	std::transform(
+	//Смещение результатов каждого запроса в общем векторе.
+	std::vector<size_t> offsets(result.size());
+	std::transform_exclusive_scan(
 		std::execution::par,
-		queries.begin(), queries.end(), //
-		result.begin(),
-		[&search_server](std::string str) {return search_server.FindTopDocuments(str); }
+		result.begin(), result.end(),
+		offsets.begin(),
+		size_t{ 0 }, std::plus<>(),
+		[](const std::vector<Document>& docs) {return docs.size(); }
 	);
-	{
-		bool is_first = true;
-		for (std::vector<Document>& docs : result) {
-			if (is_first) {
-				is_first = false;
-			}
-			else {
-				result[0].insert(result[0].end(), std::move_iterator(docs.begin()), std::move_iterator(docs.end()));
-			}
+	const size_t total = result.empty() ? 0 : offsets.back() + result.back().size();
 
+	std::vector<Document> result_to_return(total);
+	std::for_each(
+		std::execution::par,
+		result.begin(), result.end(),
+		[&](const std::vector<Document>& docs) {
+			const size_t query = &docs - result.data();
+			std::copy(docs.begin(), docs.end(), result_to_return.begin() + offsets[query]);
 		}
+	);
+	return result_to_return;
+}
+
+JoinedDocuments::JoinedDocuments(std::vector<std::vector<Document>> results)
+	:results_(std::move(results))
+{
+	for (const std::vector<Document>& docs : results_) {
+		size_ += docs.size();
 	}
+}
 
-	return result[0];
-}
\ No newline at end of file
+JoinedDocuments::Iterator JoinedDocuments::begin() const {
+	return Iterator(&results_, 0, 0);
+}
+
+JoinedDocuments::Iterator JoinedDocuments::end() const {
+	return Iterator(&results_, results_.size(), 0);
+}
+
+size_t JoinedDocuments::size() const {
+	return size_;
+}
+
+bool JoinedDocuments::empty() const {
+	return size_ == 0;
+}
+
+JoinedDocuments ProcessQueriesJoinedView(const SearchServer& search_server, const std::vector<std::string>& queries) {
+	return JoinedDocuments(ProcessQueries(search_server, queries));
+}
@@ -2,12 +2,107 @@
 
 #include <vector>
 #include <list>
+#include <iterator>
 #include "search_server.h"
 
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries);
 
+//Пакет от min_batch_queries запросов параллелится между запросами,
+//меньший ищется по одному запросу с adaptive_execution, см. GetExecutionThresholds.
+std::vector<std::vector<Document>> ProcessQueries(
+    AdaptiveExecutionPolicy policy,
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries);
+
+//Запросы раздаются потокам пула политики блоками подряд идущих номеров,
+//каждый запрос ищется последовательно в закреплённом потоке.
+std::vector<std::vector<Document>> ProcessQueries(
+    NumaExecutionPolicy policy,
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries);
+
 std::vector<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
     const std::vector<std::string>& queries);
+
+//Результаты всех запросов подряд, без копирования в общий вектор.
+class JoinedDocuments {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Document;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Document*;
+        using reference = const Document&;
+
+        Iterator(const std::vector<std::vector<Document>>* results, size_t query, size_t position)
+            :results_(results)
+            , query_(query)
+            , position_(position)
+        {
+            SkipEmpty();
+        }
+
+        reference operator*() const {
+            return (*results_)[query_][position_];
+        }
+
+        pointer operator->() const {
+            return &**this;
+        }
+
+        Iterator& operator++() {
+            ++position_;
+            SkipEmpty();
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return query_ == other.query_ && position_ == other.position_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        const std::vector<std::vector<Document>>* results_;
+        size_t query_;
+        size_t position_;
+
+        //Переходит к следующему запросу, если документы текущего кончились.
+        void SkipEmpty() {
+            while (query_ < results_->size() && position_ == (*results_)[query_].size()) {
+                ++query_;
+                position_ = 0;
+            }
+        }
+    };
+
+    explicit JoinedDocuments(std::vector<std::vector<Document>> results);
+
+    Iterator begin() const;
+
+    Iterator end() const;
+
+    size_t size() const;
+
+    bool empty() const;
+
+private:
+    std::vector<std::vector<Document>> results_;
+    size_t size_ = 0;
+};
+
+JoinedDocuments ProcessQueriesJoinedView(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries);
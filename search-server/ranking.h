@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+//Функции ранжирования. Ранжировщик создаётся один раз на слово запроса,
+//а в цикле по документам вызывается только его operator() - без виртуальных
+//вызовов, поэтому смена модели не добавляет косвенности на каждый документ.
+
+enum class RankingModel {
+    TF_IDF,
+    BM25,
+};
+
+struct CorpusStats {
+    size_t document_count;
+    double average_document_length;
+};
+
+class TfIdfRanker {
+public:
+    TfIdfRanker(const CorpusStats& corpus, size_t document_freq)
+        :inverse_document_freq_(std::log(corpus.document_count * 1.0 / document_freq))
+    {}
+
+    double operator()(double term_count, double document_length) const {
+        return term_count / document_length * inverse_document_freq_;
+    }
+
+private:
+    double inverse_document_freq_;
+};
+
+class Bm25Ranker {
+public:
+    static constexpr double K1 = 1.2;
+    static constexpr double B = 0.75;
+
+    Bm25Ranker(const CorpusStats& corpus, size_t document_freq)
+        :inverse_document_freq_(std::log(1.0 + (corpus.document_count - document_freq + 0.5) / (document_freq + 0.5)))
+        , length_factor_(corpus.average_document_length > 0 ? K1 * B / corpus.average_document_length : 0.0)
+    {}
+
+    double operator()(double term_count, double document_length) const {
+        return inverse_document_freq_ * term_count * (K1 + 1) / (term_count + K1 * (1 - B) + length_factor_ * document_length);
+    }
+
+private:
+    double inverse_document_freq_;
+    double length_factor_;
+};
+
+template <typename Ranker>
+struct RankerTag {
+    using type = Ranker;
+};
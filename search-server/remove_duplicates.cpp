@@ -1,29 +1,21 @@
 #include "remove_duplicates.h"
 #include "log_duration.h"
 
-#include <algorithm>
-#include <set>
+#include <string>
+#include <vector>
 
 using namespace std::string_literals;
 
-void RemoveDuplicates(SearchServer& search_server) {
-	std::set<int> id_to_delete;
-
-	std::set<std::set<std::string_view>> words_set;
-
-	for (int doc_id : search_server) {
-		std::set< std::string_view> words;
-
-		for (const auto& [word, nouseddouble] : search_server.GetWordFrequencies(doc_id)) {
-			words.insert(word);
-		}
-		if (!words_set.emplace(words).second) {
-			id_to_delete.insert(doc_id);
-		}
-	}
+void RemoveDuplicates(SearchServer& search_server, std::ostream& out) {
+	//Группы одинаковых наборов слов поддерживает сам сервер, остаётся пройти по ним.
+	const std::vector<int> id_to_delete = search_server.FindDuplicateDocuments();
 
+	std::string report;
 	for (int id : id_to_delete) {
-		std::cout << "Found duplicate document id "s << id << std::endl;
+		report += "Found duplicate document id "s;
+		report += std::to_string(id);
+		report += '\n';
 		search_server.RemoveDocument(id);
 	}
-}
\ No newline at end of file
+	out << report;
+}
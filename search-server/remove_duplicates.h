@@ -1,8 +1,11 @@
 #pragma once
 
 #include "search_server.h"
+#include <iostream>
 #include <map>
 
-void RemoveDuplicates(SearchServer& search_server);
+//Удаляет документы, набор слов которых совпадает с документом с меньшим id.
+//Отчёт об удалённых собирается целиком и выводится в out одной записью.
+void RemoveDuplicates(SearchServer& search_server, std::ostream& out = std::cout);
 
 bool map_key_cheker(const std::map <std::string, double>& map1, const std::map <std::string, double>& map2);
@@ -1,61 +1,48 @@
 #include "request_queue.h"
 
-RequestQueue::RequestQueue(const SearchServer& search_server)
+RequestQueue::RequestQueue(const SearchServer& search_server, std::chrono::seconds history)
     :search_server_(search_server)
+    , statistics_(history)
+    , recent_empty_(min_in_day_)
 {
 }
 
-std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status) {
-    std::vector<Document>result = search_server_.FindTopDocuments(raw_query, status);
-    NewRequest(result);
+std::vector<Document> RequestQueue::AddFindRequest(std::string_view raw_query, DocumentStatus status) {
+    const auto start = RequestStatistics::Clock::now();
+    std::vector<Document> result = FindWithCache(raw_query, status);
+    NewRequest(result, start);
     return result;
 }
-std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query) {
-    std::vector<Document> result = search_server_.FindTopDocuments(raw_query);
-    NewRequest(result);
+std::vector<Document> RequestQueue::AddFindRequest(std::string_view raw_query) {
+    const auto start = RequestStatistics::Clock::now();
+    std::vector<Document> result = FindWithCache(raw_query, DocumentStatus::ACTUAL);
+    NewRequest(result, start);
     return result;
 }
 
 int RequestQueue::GetNoResultRequests() const {
-    return empty_count_;
-}
-
-bool RequestQueue::IsNewDay() {
-    if (clock_ >= min_in_day_) {
-        ++clock_;
-        return true;
-    }
-    else {
-        ++clock_;
-        return false;
-    }
-}
-
-void RequestQueue::NewRequest(const std::vector<Document>& doc) {
-    if (!IsNewDay()) {
-        RequestQueue::QueryResult toadd;
-        bool flag = (doc.begin() == doc.end());
-        toadd.isempty_ = flag;
-        if (flag) {
-            ++empty_count_;
-        }
-        toadd.timestamp = clock_;
-        //toadd.search_result_ = doc;
-        requests_.push_back(toadd);
-    }
-    else {
-        QueryResult toadd;
-        bool flag = (doc.begin() == doc.end());
-        toadd.isempty_ = flag;
-        if (flag) {
-            ++empty_count_;
-        }
-        toadd.timestamp = clock_;
-        //toadd.search_result_ = doc;
-        if (requests_.front().isempty_) {
-            --empty_count_;
-        }
-        requests_.pop_front();
-        requests_.push_back(toadd);
-    }
-}
\ No newline at end of file
+    return empty_count_.load(std::memory_order_relaxed);
+}
+
+RequestWindowStats RequestQueue::GetStatistics(std::chrono::seconds window) const {
+    return statistics_.GetStats(window);
+}
+
+void RequestQueue::EnableResultCache(size_t capacity) {
+    cache_ = std::make_unique<ResultCache>(capacity);
+}
+
+ResultCacheStats RequestQueue::GetCacheStats() const {
+    return cache_ ? cache_->GetStats() : ResultCacheStats{};
+}
+
+void RequestQueue::NewRequest(const std::vector<Document>& doc, RequestStatistics::Clock::time_point start) {
+    const auto now = RequestStatistics::Clock::now();
+    const bool is_empty = doc.empty();
+    statistics_.Record(is_empty, now - start, now);
+
+    //Новый запрос вытесняет из кольца запрос min_in_day_ шагов назад.
+    const uint64_t index = request_count_.fetch_add(1, std::memory_order_relaxed) % min_in_day_;
+    const bool was_empty = recent_empty_[index].exchange(is_empty, std::memory_order_relaxed);
+    empty_count_.fetch_add(static_cast<int>(is_empty) - static_cast<int>(was_empty), std::memory_order_relaxed);
+}
@@ -1,51 +1,84 @@
 #pragma once
 
-#include <stack>
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <vector>
-#include <string>
-#include <iostream>
+#include <string_view>
 
 #include "document.h"
 #include "search_server.h"
+#include "request_statistics.h"
+#include "result_cache.h"
 
+//Обёртка над поиском, собирающая статистику запросов.
+//AddFindRequest можно вызывать из нескольких потоков одновременно.
 class RequestQueue {
 public:
-    explicit RequestQueue(const SearchServer& search_server);
+    explicit RequestQueue(const SearchServer& search_server, std::chrono::seconds history = RequestStatistics::DEFAULT_HISTORY);
 
     template <typename DocumentPredicate>
-    std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate);
+    std::vector<Document> AddFindRequest(std::string_view raw_query, DocumentPredicate document_predicate);
 
-    std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentStatus status);
-
-    std::vector<Document> AddFindRequest(const std::string& raw_query);
+    std::vector<Document> AddFindRequest(std::string_view raw_query, DocumentStatus status);
 
+    std::vector<Document> AddFindRequest(std::string_view raw_query);
 
+    //Число пустых ответов среди последних min_in_day_ запросов.
     int GetNoResultRequests() const;
 
+    //QPS, доля пустых ответов и перцентили задержки за последние window секунд.
+    RequestWindowStats GetStatistics(std::chrono::seconds window) const;
 
+    //Включает кэш результатов на capacity запросов. Запросы с произвольным
+    //предикатом не кэшируются: их нельзя сравнить между собой.
+    void EnableResultCache(size_t capacity);
 
-private:
-    struct QueryResult {
-        bool isempty_;
-        uint64_t timestamp;
-    };
-    std::deque<QueryResult> requests_;
+    ResultCacheStats GetCacheStats() const;
 
+private:
     const static int min_in_day_ = 1440;
 
     const SearchServer& search_server_;
-    size_t clock_ = 0;
-    int empty_count_ = 0;
+    RequestStatistics statistics_;
+    std::unique_ptr<ResultCache> cache_;
 
-    bool IsNewDay();
+    //Кольцо признаков пустого ответа последних min_in_day_ запросов.
+    std::vector<std::atomic<bool>> recent_empty_;
+    std::atomic<uint64_t> request_count_{ 0 };
+    std::atomic<int> empty_count_{ 0 };
 
-    void NewRequest(const std::vector<Document>& doc);
+    void NewRequest(const std::vector<Document>& doc, RequestStatistics::Clock::time_point start);
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindWithCache(std::string_view raw_query, DocumentPredicate document_predicate);
 
 };
 
 template <typename DocumentPredicate>
-std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
-    std::vector<Document> result = search_server_.FindTopDocuments<DocumentPredicate>(raw_query, document_predicate);
-    NewRequest(result);
+std::vector<Document> RequestQueue::AddFindRequest(std::string_view raw_query, DocumentPredicate document_predicate) {
+    const auto start = RequestStatistics::Clock::now();
+    std::vector<Document> result = FindWithCache(raw_query, document_predicate);
+    NewRequest(result, start);
+    return result;
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> RequestQueue::FindWithCache(std::string_view raw_query, DocumentPredicate document_predicate) {
+    std::optional<std::string> filter_key;
+    if (cache_) {
+        filter_key = FindFilterCacheKey(document_predicate);
+    }
+    if (!filter_key) {
+        return search_server_.FindTopDocuments(raw_query, document_predicate);
+    }
+
+    const std::string key = *filter_key + '\n' + search_server_.NormalizeQuery(raw_query);
+    const uint64_t generation = search_server_.GetGeneration();
+    if (std::optional<std::vector<Document>> cached = cache_->Find(key, generation)) {
+        return std::move(*cached);
+    }
+    std::vector<Document> result = search_server_.FindTopDocuments(raw_query, document_predicate);
+    cache_->Insert(key, generation, result);
     return result;
 }
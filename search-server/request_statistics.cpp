@@ -0,0 +1,127 @@
+#include "request_statistics.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+using namespace std::string_literals;
+
+RequestStatistics::RequestStatistics(std::chrono::seconds history)
+    :start_(Clock::now())
+    , history_seconds_(history.count() > 0 ? static_cast<size_t>(history.count()) : 0)
+    , shard_count_(std::clamp<size_t>(std::thread::hardware_concurrency(), 1, MAX_SHARD_COUNT))
+{
+    if (history_seconds_ == 0) {
+        throw std::invalid_argument("statistics history must be positive"s);
+    }
+    buckets_ = std::make_unique<Bucket[]>(shard_count_ * history_seconds_);
+}
+
+void RequestStatistics::Record(bool is_empty, Clock::duration latency, Clock::time_point now) {
+    const int64_t second = ToSecond(now);
+    if (second < 0) {
+        return;
+    }
+    Bucket& bucket = GetBucket(GetThreadIndex() % shard_count_, second);
+
+    int64_t bucket_second = bucket.second.load(std::memory_order_acquire);
+    if (bucket_second != second) {
+        //Корзину обнуляет поток, первым сменивший её секунду. Замеры, которые
+        //пришли в этот момент из других потоков того же шарда, теряются.
+        if (bucket_second > second || !bucket.second.compare_exchange_strong(bucket_second, second, std::memory_order_acq_rel)) {
+            return;
+        }
+        bucket.request_count.store(0, std::memory_order_relaxed);
+        bucket.empty_count.store(0, std::memory_order_relaxed);
+        for (auto& count : bucket.latency_counts) {
+            count.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    bucket.request_count.fetch_add(1, std::memory_order_relaxed);
+    if (is_empty) {
+        bucket.empty_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    bucket.latency_counts[GetLatencyBucket(latency)].fetch_add(1, std::memory_order_relaxed);
+}
+
+RequestWindowStats RequestStatistics::GetStats(std::chrono::seconds window, Clock::time_point now) const {
+    RequestWindowStats stats;
+    const int64_t last_second = ToSecond(now);
+    //Пока сервер работает меньше окна, QPS считаем по прошедшему времени.
+    const int64_t window_seconds = std::min<int64_t>({ window.count(), static_cast<int64_t>(history_seconds_), last_second + 1 });
+    if (window_seconds <= 0) {
+        return stats;
+    }
+
+    uint64_t latency_counts[LATENCY_BUCKET_COUNT] = {};
+    for (size_t shard = 0; shard < shard_count_; ++shard) {
+        for (int64_t second = last_second - window_seconds + 1; second <= last_second; ++second) {
+            const Bucket& bucket = GetBucket(shard, second);
+            if (bucket.second.load(std::memory_order_acquire) != second) {
+                continue;
+            }
+            stats.request_count += bucket.request_count.load(std::memory_order_relaxed);
+            stats.empty_count += bucket.empty_count.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < LATENCY_BUCKET_COUNT; ++i) {
+                latency_counts[i] += bucket.latency_counts[i].load(std::memory_order_relaxed);
+            }
+        }
+    }
+    if (stats.request_count == 0) {
+        return stats;
+    }
+
+    stats.queries_per_second = stats.request_count * 1.0 / window_seconds;
+    stats.empty_rate = stats.empty_count * 1.0 / stats.request_count;
+
+    uint64_t latency_total = 0;
+    for (const uint64_t count : latency_counts) {
+        latency_total += count;
+    }
+    auto percentile = [&](double fraction) {
+        const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(fraction * latency_total + 0.5));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < LATENCY_BUCKET_COUNT; ++i) {
+            seen += latency_counts[i];
+            if (seen >= rank) {
+                return std::chrono::microseconds(int64_t{ 1 } << i);
+            }
+        }
+        return std::chrono::microseconds(int64_t{ 1 } << (LATENCY_BUCKET_COUNT - 1));
+    };
+    stats.latency_p50 = percentile(0.50);
+    stats.latency_p90 = percentile(0.90);
+    stats.latency_p99 = percentile(0.99);
+    return stats;
+}
+
+std::chrono::seconds RequestStatistics::GetHistory() const {
+    return std::chrono::seconds(history_seconds_);
+}
+
+int64_t RequestStatistics::ToSecond(Clock::time_point time) const {
+    return std::chrono::duration_cast<std::chrono::seconds>(time - start_).count();
+}
+
+RequestStatistics::Bucket& RequestStatistics::GetBucket(size_t shard, int64_t second) const {
+    return buckets_[shard * history_seconds_ + static_cast<size_t>(second) % history_seconds_];
+}
+
+size_t RequestStatistics::GetThreadIndex() {
+    static std::atomic<size_t> next_thread_index{ 0 };
+    thread_local const size_t thread_index = next_thread_index.fetch_add(1, std::memory_order_relaxed);
+    return thread_index;
+}
+
+//Интервал i содержит задержки из [2^(i-1), 2^i) микросекунд, интервал 0 - меньше микросекунды.
+size_t RequestStatistics::GetLatencyBucket(Clock::duration latency) {
+    uint64_t microseconds = static_cast<uint64_t>(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::microseconds>(latency).count()));
+    size_t bucket = 0;
+    while (microseconds > 0 && bucket + 1 < LATENCY_BUCKET_COUNT) {
+        microseconds >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
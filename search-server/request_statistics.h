@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+struct RequestWindowStats {
+    uint64_t request_count = 0;
+    uint64_t empty_count = 0;
+    double queries_per_second = 0.0;
+    double empty_rate = 0.0;
+    //Верхние границы интервалов гистограммы, точность - степень двойки.
+    std::chrono::microseconds latency_p50{ 0 };
+    std::chrono::microseconds latency_p90{ 0 };
+    std::chrono::microseconds latency_p99{ 0 };
+};
+
+//Статистика запросов в скользящем окне по реальному времени.
+//Каждый поток пишет в свой шард - кольцо секундных корзин с атомарными
+//счётчиками, поэтому Record не берёт блокировок. GetStats сводит корзины
+//всех шардов за последние window секунд.
+class RequestStatistics {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::chrono::seconds DEFAULT_HISTORY{ 300 };
+    static constexpr size_t LATENCY_BUCKET_COUNT = 24;
+    static constexpr size_t MAX_SHARD_COUNT = 16;
+
+    explicit RequestStatistics(std::chrono::seconds history = DEFAULT_HISTORY);
+
+    void Record(bool is_empty, Clock::duration latency, Clock::time_point now = Clock::now());
+
+    //window ограничивается глубиной истории.
+    RequestWindowStats GetStats(std::chrono::seconds window, Clock::time_point now = Clock::now()) const;
+
+    std::chrono::seconds GetHistory() const;
+
+private:
+    //Корзина одной секунды. second - номер секунды от start_, по нему
+    //видно, что корзина устарела и её пора обнулить.
+    struct alignas(64) Bucket {
+        std::atomic<int64_t> second{ -1 };
+        std::atomic<uint64_t> request_count{ 0 };
+        std::atomic<uint64_t> empty_count{ 0 };
+        std::atomic<uint64_t> latency_counts[LATENCY_BUCKET_COUNT] = {};
+    };
+
+    const Clock::time_point start_;
+    const size_t history_seconds_;
+    const size_t shard_count_;
+    std::unique_ptr<Bucket[]> buckets_;
+
+    int64_t ToSecond(Clock::time_point time) const;
+
+    Bucket& GetBucket(size_t shard, int64_t second) const;
+
+    static size_t GetThreadIndex();
+
+    static size_t GetLatencyBucket(Clock::duration latency);
+};
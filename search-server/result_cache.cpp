@@ -0,0 +1,90 @@
+#include "result_cache.h"
+
+#include <functional>
+#include <stdexcept>
+
+using namespace std::string_literals;
+
+ResultCache::ResultCache(size_t capacity)
+    :shard_capacity_((capacity + SHARD_COUNT - 1) / SHARD_COUNT)
+    , shards_(SHARD_COUNT)
+{
+    if (capacity == 0) {
+        throw std::invalid_argument("cache capacity must be positive"s);
+    }
+}
+
+std::optional<std::vector<Document>> ResultCache::Find(const std::string& key, uint64_t generation) {
+    Shard& shard = GetShard(key);
+    std::lock_guard guard(shard.mutex);
+
+    const auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+    if (it->second->generation != generation) {
+        shard.entries.erase(it->second);
+        shard.index.erase(it);
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    return it->second->documents;
+}
+
+void ResultCache::Insert(const std::string& key, uint64_t generation, std::vector<Document> documents) {
+    Shard& shard = GetShard(key);
+    std::lock_guard guard(shard.mutex);
+
+    if (const auto it = shard.index.find(key); it != shard.index.end()) {
+        it->second->generation = generation;
+        it->second->documents = std::move(documents);
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        return;
+    }
+
+    if (shard.entries.size() >= shard_capacity_) {
+        shard.index.erase(shard.entries.back().key);
+        shard.entries.pop_back();
+    }
+    shard.entries.push_front({ key, generation, std::move(documents) });
+    //Ключ индекса ссылается на строку внутри элемента списка, она не перемещается.
+    shard.index.emplace(shard.entries.front().key, shard.entries.begin());
+}
+
+ResultCacheStats ResultCache::GetStats() const {
+    ResultCacheStats stats;
+    stats.hits = hits_.load(std::memory_order_relaxed);
+    stats.misses = misses_.load(std::memory_order_relaxed);
+    for (const Shard& shard : shards_) {
+        std::lock_guard guard(shard.mutex);
+        stats.size += shard.entries.size();
+    }
+    return stats;
+}
+
+ResultCache::Shard& ResultCache::GetShard(const std::string& key) {
+    return shards_[std::hash<std::string>{}(key) % SHARD_COUNT];
+}
+
+std::string MakeFilterCacheKey(DocumentStatus status) {
+    return MakeFilterCacheKey(StatusIs{ status });
+}
+
+std::string MakeFilterCacheKey(AnyDocument filter) {
+    return "any"s;
+}
+
+std::string MakeFilterCacheKey(StatusIs filter) {
+    return "status:"s + std::to_string(static_cast<int>(filter.status));
+}
+
+std::string MakeFilterCacheKey(RatingBetween filter) {
+    return "rating:"s + std::to_string(filter.min_rating) + ':' + std::to_string(filter.max_rating);
+}
+
+std::string MakeFilterCacheKey(IdModulo filter) {
+    return "id_mod:"s + std::to_string(filter.divisor) + ':' + std::to_string(filter.remainder);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "document.h"
+#include "document_filters.h"
+
+struct ResultCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    size_t size = 0;
+};
+
+//Кэш результатов поиска. Ключи распределены по шардам, в каждом свой LRU
+//и своя блокировка. Запись помнит поколение индекса (SearchServer::GetGeneration),
+//при котором посчитана: с другим поколением она считается промахом.
+class ResultCache {
+public:
+    static constexpr size_t SHARD_COUNT = 16;
+
+    explicit ResultCache(size_t capacity);
+
+    std::optional<std::vector<Document>> Find(const std::string& key, uint64_t generation);
+
+    void Insert(const std::string& key, uint64_t generation, std::vector<Document> documents);
+
+    ResultCacheStats GetStats() const;
+
+private:
+    struct Entry {
+        std::string key;
+        uint64_t generation;
+        std::vector<Document> documents;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::list<Entry> entries; //От недавно использованных к давним.
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+    };
+
+    const size_t shard_capacity_;
+    std::vector<Shard> shards_;
+    std::atomic<uint64_t> hits_{ 0 };
+    std::atomic<uint64_t> misses_{ 0 };
+
+    Shard& GetShard(const std::string& key);
+};
+
+//Ключ фильтра для кэша. Фильтры из document_filters.h и статус сравнимы
+//по значению; для произвольных предикатов ключа нет и кэш не используется.
+std::string MakeFilterCacheKey(DocumentStatus status);
+
+std::string MakeFilterCacheKey(AnyDocument filter);
+
+std::string MakeFilterCacheKey(StatusIs filter);
+
+std::string MakeFilterCacheKey(RatingBetween filter);
+
+std::string MakeFilterCacheKey(IdModulo filter);
+
+template <typename Filter>
+std::optional<std::string> FindFilterCacheKey(const Filter& filter) {
+    if constexpr (std::is_same_v<Filter, DocumentStatus> || std::is_same_v<Filter, AnyDocument> || std::is_same_v<Filter, StatusIs>
+        || std::is_same_v<Filter, RatingBetween> || std::is_same_v<Filter, IdModulo>) {
+        return MakeFilterCacheKey(filter);
+    }
+    else {
+        return std::nullopt;
+    }
+}
@@ -0,0 +1,193 @@
+#include "roaring_bitmap.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+uint16_t HighBits(uint32_t value) {
+    return static_cast<uint16_t>(value >> 16);
+}
+
+uint16_t LowBits(uint32_t value) {
+    return static_cast<uint16_t>(value & 0xFFFF);
+}
+
+uint32_t CountBits(uint64_t word) {
+    uint32_t count = 0;
+    for (; word != 0; word &= word - 1) {
+        ++count;
+    }
+    return count;
+}
+}
+
+void RoaringBitmap::Add(uint32_t value) {
+    const uint16_t key = HighBits(value);
+    const auto key_it = std::lower_bound(keys_.begin(), keys_.end(), key);
+    const size_t index = key_it - keys_.begin();
+    if (key_it == keys_.end() || *key_it != key) {
+        keys_.insert(key_it, key);
+        containers_.insert(containers_.begin() + index, Container{});
+    }
+    if (containers_[index].Add(LowBits(value))) {
+        ++size_;
+    }
+}
+
+void RoaringBitmap::Remove(uint32_t value) {
+    const uint16_t key = HighBits(value);
+    const auto key_it = std::lower_bound(keys_.begin(), keys_.end(), key);
+    if (key_it == keys_.end() || *key_it != key) {
+        return;
+    }
+    const size_t index = key_it - keys_.begin();
+    if (containers_[index].Remove(LowBits(value))) {
+        --size_;
+        if (containers_[index].cardinality == 0) {
+            keys_.erase(key_it);
+            containers_.erase(containers_.begin() + index);
+        }
+    }
+}
+
+bool RoaringBitmap::Contains(uint32_t value) const {
+    const uint16_t key = HighBits(value);
+    const auto key_it = std::lower_bound(keys_.begin(), keys_.end(), key);
+    if (key_it == keys_.end() || *key_it != key) {
+        return false;
+    }
+    return containers_[key_it - keys_.begin()].Contains(LowBits(value));
+}
+
+void RoaringBitmap::UnionWith(const RoaringBitmap& other) {
+    for (size_t other_index = 0; other_index < other.keys_.size(); ++other_index) {
+        const uint16_t key = other.keys_[other_index];
+        const auto key_it = std::lower_bound(keys_.begin(), keys_.end(), key);
+        const size_t index = key_it - keys_.begin();
+        if (key_it == keys_.end() || *key_it != key) {
+            keys_.insert(key_it, key);
+            containers_.insert(containers_.begin() + index, other.containers_[other_index]);
+            size_ += other.containers_[other_index].cardinality;
+            continue;
+        }
+        size_ -= containers_[index].cardinality;
+        containers_[index].UnionWith(other.containers_[other_index]);
+        size_ += containers_[index].cardinality;
+    }
+}
+
+size_t RoaringBitmap::size() const {
+    return size_;
+}
+
+bool RoaringBitmap::empty() const {
+    return size_ == 0;
+}
+
+bool RoaringBitmap::Container::Contains(uint16_t value) const {
+    if (!bits.empty()) {
+        return (bits[value / 64] >> (value % 64)) & 1;
+    }
+    return std::binary_search(values.begin(), values.end(), value);
+}
+
+bool RoaringBitmap::Container::Add(uint16_t value) {
+    if (!bits.empty()) {
+        uint64_t& word = bits[value / 64];
+        const uint64_t mask = uint64_t{ 1 } << (value % 64);
+        if (word & mask) {
+            return false;
+        }
+        word |= mask;
+        ++cardinality;
+        return true;
+    }
+
+    const auto it = std::lower_bound(values.begin(), values.end(), value);
+    if (it != values.end() && *it == value) {
+        return false;
+    }
+    values.insert(it, value);
+    ++cardinality;
+    if (cardinality > ARRAY_CONTAINER_MAX_SIZE) {
+        ConvertToBitset();
+    }
+    return true;
+}
+
+bool RoaringBitmap::Container::Remove(uint16_t value) {
+    if (!bits.empty()) {
+        uint64_t& word = bits[value / 64];
+        const uint64_t mask = uint64_t{ 1 } << (value % 64);
+        if (!(word & mask)) {
+            return false;
+        }
+        word &= ~mask;
+        --cardinality;
+        if (cardinality <= ARRAY_CONTAINER_MAX_SIZE / 2) {
+            ConvertToArray();
+        }
+        return true;
+    }
+
+    const auto it = std::lower_bound(values.begin(), values.end(), value);
+    if (it == values.end() || *it != value) {
+        return false;
+    }
+    values.erase(it);
+    --cardinality;
+    return true;
+}
+
+void RoaringBitmap::Container::UnionWith(const Container& other) {
+    if (bits.empty() && other.bits.empty()) {
+        std::vector<uint16_t> merged;
+        merged.reserve(values.size() + other.values.size());
+        std::set_union(values.begin(), values.end(), other.values.begin(), other.values.end(), std::back_inserter(merged));
+        values = std::move(merged);
+        cardinality = static_cast<uint32_t>(values.size());
+        if (cardinality > ARRAY_CONTAINER_MAX_SIZE) {
+            ConvertToBitset();
+        }
+        return;
+    }
+
+    ConvertToBitset();
+    if (!other.bits.empty()) {
+        cardinality = 0;
+        for (size_t i = 0; i < BITSET_WORD_COUNT; ++i) {
+            bits[i] |= other.bits[i];
+            cardinality += CountBits(bits[i]);
+        }
+    }
+    else {
+        for (const uint16_t value : other.values) {
+            Add(value);
+        }
+    }
+}
+
+void RoaringBitmap::Container::ConvertToBitset() {
+    if (!bits.empty()) {
+        return;
+    }
+    bits.assign(BITSET_WORD_COUNT, 0);
+    for (const uint16_t value : values) {
+        bits[value / 64] |= uint64_t{ 1 } << (value % 64);
+    }
+    values.clear();
+    values.shrink_to_fit();
+}
+
+void RoaringBitmap::Container::ConvertToArray() {
+    values.reserve(cardinality);
+    for (size_t i = 0; i < BITSET_WORD_COUNT; ++i) {
+        for (size_t bit = 0; bit < 64; ++bit) {
+            if ((bits[i] >> bit) & 1) {
+                values.push_back(static_cast<uint16_t>(i * 64 + bit));
+            }
+        }
+    }
+    bits.clear();
+    bits.shrink_to_fit();
+}
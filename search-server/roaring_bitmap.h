@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//Сжатое множество неотрицательных чисел в духе Roaring bitmap.
+//Старшие 16 бит значения выбирают контейнер, младшие хранятся в нём:
+//отсортированным массивом, пока их не больше ARRAY_CONTAINER_MAX_SIZE,
+//иначе битовой картой на 65536 бит.
+class RoaringBitmap {
+public:
+    void Add(uint32_t value);
+
+    void Remove(uint32_t value);
+
+    bool Contains(uint32_t value) const;
+
+    void UnionWith(const RoaringBitmap& other);
+
+    size_t size() const;
+
+    bool empty() const;
+
+private:
+    static constexpr size_t ARRAY_CONTAINER_MAX_SIZE = 4096;
+    static constexpr size_t BITSET_WORD_COUNT = (1 << 16) / 64;
+
+    struct Container {
+        std::vector<uint16_t> values; //Используется, пока bits пуст.
+        std::vector<uint64_t> bits;
+        uint32_t cardinality = 0;
+
+        bool Contains(uint16_t value) const;
+
+        bool Add(uint16_t value);
+
+        bool Remove(uint16_t value);
+
+        void UnionWith(const Container& other);
+
+        void ConvertToBitset();
+
+        void ConvertToArray();
+    };
+
+    std::vector<uint16_t> keys_; //Отсортированы, containers_[i] соответствует keys_[i].
+    std::vector<Container> containers_;
+    size_t size_ = 0;
+};
@@ -1,108 +1,911 @@
 #include "search_server.h"
 #include "read_input_functions.h"
+#include "sorted_intersection.h"
 
 #include <utility>
 #include <iostream>
 #include <algorithm>
 #include <numeric>
 #include <cmath>
+#include <thread>
+#include <functional>
 
 using namespace std::string_literals; //
 
 
 void SearchServer::AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    AddDocument(document_id, document, nullptr, status, ratings);
+}
+
+void SearchServer::AddDocument(int document_id, const std::string_view document, std::shared_ptr<const void> buffer_owner, DocumentStatus status, const std::vector<int>& ratings) {
+    StoreDocument(document_id, document, std::move(buffer_owner), status, ratings, true);
+}
+
+void SearchServer::StoreDocument(int document_id, const std::string_view document, std::shared_ptr<const void> buffer_owner, DocumentStatus status, const std::vector<int>& ratings, bool insert_postings) {
     if (document_id < 0) {
         throw std::invalid_argument("wrong id"s);
     }
-    if (documents_.count(document_id)) {
+    if (HasDocument(document_id)) {
         throw std::invalid_argument("already exist id"s);
     }
     if (!IsValidWord(document)) {
         throw std::invalid_argument("wrong document"s);
     }
 
-    const std::vector<std::string_view> words = SplitIntoWordsNoStop(document);
+    const void* buffer_key = buffer_owner.get();
+    SharedBuffer* buffer = nullptr;
+    if (buffer_key != nullptr) {
+        buffer = &shared_buffers_[buffer_key];
+        if (!buffer->owner) {
+            buffer->owner = std::move(buffer_owner);
+        }
+    }
+
+    std::vector<uint32_t> positions;
+    std::vector<int> term_ids = SplitIntoWordsNoStop(document, positional_index_enabled_ ? &positions : nullptr, buffer);
+
+    const double inv_word_count = 1.0 / term_ids.size();
+
+    if (positional_index_enabled_) {
+        //Сортируем слова вместе с позициями: позиции слова окажутся по возрастанию.
+        std::vector<std::pair<int, uint32_t>> occurrences(term_ids.size());
+        for (size_t i = 0; i < term_ids.size(); ++i) {
+            occurrences[i] = { term_ids[i], positions[i] };
+        }
+        std::sort(occurrences.begin(), occurrences.end());
+        for (size_t i = 0; i < occurrences.size(); ++i) {
+            term_ids[i] = occurrences[i].first;
+            positions[i] = occurrences[i].second;
+        }
+    }
+    else {
+        std::sort(term_ids.begin(), term_ids.end());
+    }
+
+    const uint64_t fingerprint = ComputeFingerprint(term_ids);
+    std::vector<int>& fingerprint_group = fingerprint_documents_[fingerprint];
+    if (duplicate_policy_ == DuplicatePolicy::REJECT && HasSameTermsDocument(fingerprint_group, term_ids)) {
+        if (buffer != nullptr && buffer->document_count == 0) {
+            RetireSharedBuffer(buffer_key);
+        }
+        throw std::invalid_argument("duplicate document"s);
+    }
+    fingerprint_group.push_back(document_id);
+
+    document_ordinals_.emplace(document_id, document_ids_.size());
+    document_ids_.push_back(document_id);
+    document_ratings_.push_back(ComputeAverageRating(ratings));
+    document_statuses_.push_back(status);
+    document_lengths_.push_back(static_cast<uint32_t>(term_ids.size()));
+    document_buffers_.push_back(buffer_key);
+    document_fingerprints_.push_back(fingerprint);
+    forward_offsets_.push_back(forward_terms_.size());
+    total_document_length_ += term_ids.size();
+
+    //Повторы слова идут подряд: сворачиваем их в одну запись с частотой.
+    for (auto it = term_ids.begin(); it != term_ids.end();) {
+        const auto run_begin = it;
+        const int term_id = *it;
+        double term_freq = 0.0;
+        for (; it != term_ids.end() && *it == term_id; ++it) {
+            term_freq += inv_word_count;
+        }
+        const uint32_t term_count = static_cast<uint32_t>(it - run_begin);
+        if (insert_postings) {
+            GetMutablePostings(term_id).Insert(status, { document_id, document_ratings_.back(), term_count, document_lengths_.back() });
+        }
+        forward_terms_.push_back(term_id);
+        forward_freqs_.push_back(term_freq);
+
+        if (positional_index_enabled_) {
+            forward_positions_.push_back(position_bytes_.size());
+            EncodePositions({ positions.begin() + (run_begin - term_ids.begin()), positions.begin() + (it - term_ids.begin()) }, position_bytes_);
+        }
+    }
+    forward_sizes_.push_back(static_cast<uint32_t>(forward_terms_.size() - forward_offsets_.back()));
+
+    //Алфавитный порядок строится один раз, чтобы GetWordFrequencies ничего не сортировал.
+    forward_word_order_.resize(forward_terms_.size());
+    SortWordOrder(document_ids_.size() - 1);
+    status_documents_[static_cast<size_t>(status)].Add(document_id);
+
+    const size_t ordinal = document_ids_.size() - 1;
+    InvalidateTermBitmaps(ForwardTermsBegin(ordinal), ForwardTermsEnd(ordinal));
+    if (buffer != nullptr) {
+        ++buffer->document_count;
+    }
+    ++generation_;
+}
+
+void SearchServer::SetDuplicatePolicy(DuplicatePolicy policy) {
+    duplicate_policy_ = policy;
+}
+
+std::optional<int> SearchServer::FindDuplicateOf(int document_id) const {
+    const size_t ordinal = GetDocumentOrdinal(document_id);
+    const std::vector<int>& group = fingerprint_documents_.at(document_fingerprints_[ordinal]);
+    std::optional<int> original;
+    for (const int other_id : group) {
+        if (other_id < document_id && (!original || other_id < *original)
+            && std::equal(ForwardTermsBegin(ordinal), ForwardTermsEnd(ordinal),
+                ForwardTermsBegin(GetDocumentOrdinal(other_id)), ForwardTermsEnd(GetDocumentOrdinal(other_id)))) {
+            original = other_id;
+        }
+    }
+    return original;
+}
+
+std::vector<int> SearchServer::FindDuplicateDocuments() const {
+    std::vector<int> duplicates;
+    for (const auto& [fingerprint, group] : fingerprint_documents_) {
+        if (group.size() < 2) {
+            continue;
+        }
+        //Внутри группы ещё могут быть разные наборы слов с одинаковым отпечатком.
+        //Оригинал каждого набора - документ с меньшим id.
+        std::vector<int> sorted_group = group;
+        std::sort(sorted_group.begin(), sorted_group.end());
+        std::vector<size_t> originals;
+        for (const int document_id : sorted_group) {
+            const size_t ordinal = GetDocumentOrdinal(document_id);
+            const bool is_duplicate = std::any_of(originals.begin(), originals.end(), [&](size_t original) {
+                return std::equal(ForwardTermsBegin(ordinal), ForwardTermsEnd(ordinal), ForwardTermsBegin(original), ForwardTermsEnd(original));
+            });
+            if (is_duplicate) {
+                duplicates.push_back(document_id);
+            }
+            else {
+                originals.push_back(ordinal);
+            }
+        }
+    }
+    std::sort(duplicates.begin(), duplicates.end());
+    return duplicates;
+}
+
+uint64_t SearchServer::ComputeFingerprint(const std::vector<int>& sorted_terms) {
+    uint64_t fingerprint = 0;
+    for (size_t i = 0; i < sorted_terms.size(); ++i) {
+        if (i > 0 && sorted_terms[i] == sorted_terms[i - 1]) {
+            continue;
+        }
+        fingerprint ^= static_cast<uint64_t>(sorted_terms[i]) + 0x9e3779b97f4a7c15ULL + (fingerprint << 6) + (fingerprint >> 2);
+    }
+    return fingerprint;
+}
+
+bool SearchServer::HasSameTermsDocument(const std::vector<int>& group, const std::vector<int>& sorted_terms) const {
+    for (const int document_id : group) {
+        const size_t ordinal = GetDocumentOrdinal(document_id);
+        const int* forward_it = ForwardTermsBegin(ordinal);
+        const int* const forward_end = ForwardTermsEnd(ordinal);
+        bool is_same = true;
+        for (size_t i = 0; i < sorted_terms.size() && is_same; ++i) {
+            if (i > 0 && sorted_terms[i] == sorted_terms[i - 1]) {
+                continue;
+            }
+            is_same = forward_it != forward_end && *forward_it++ == sorted_terms[i];
+        }
+        if (is_same && forward_it == forward_end) {
+            return true;
+        }
+    }
+    return false;
+}
 
-    const double inv_word_count = 1.0 / words.size();
+void SearchServer::SetRankingModel(RankingModel model) {
+    ranking_model_ = model;
+    ++generation_;
+}
 
-    for (const std::string_view word : words) {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
+RankingModel SearchServer::GetRankingModel() const {
+    return ranking_model_;
+}
 
-        documents_word_freqs_[document_id][word] += inv_word_count;
+void SearchServer::EnablePositionalIndex() {
+    if (GetDocumentCount() > 0) {
+        throw std::logic_error("positional index must be enabled before adding documents"s);
     }
-    documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status });
-    index_.emplace(document_id);
+    positional_index_enabled_ = true;
+}
+
+void SearchServer::EnableAdvancedQuerySyntax() {
+    advanced_query_syntax_enabled_ = true;
+    ++generation_;
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status1) const {
-    return FindTopDocuments(raw_query, [status1](int document_id, DocumentStatus status, int rating) { return status == status1; });
+    return FindTopDocuments(std::execution::seq, raw_query, status1);
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(std::execution::sequenced_policy exec, const std::string_view raw_query, DocumentStatus status1) const {
-    return FindTopDocuments(raw_query, [status1](int document_id, DocumentStatus status, int rating) { return status == status1; });
+    return FindTopDocuments(exec, raw_query, StatusIs{ status1 });
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(std::execution::parallel_policy exec, const std::string_view raw_query, DocumentStatus status1) const {
-    return FindTopDocuments(exec, raw_query, [status1](int document_id, DocumentStatus status, int rating) { return status == status1; });
+    return FindTopDocuments(exec, raw_query, StatusIs{ status1 });
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(AdaptiveExecutionPolicy exec, const std::string_view raw_query, DocumentStatus status1) const {
+    return FindTopDocuments(exec, raw_query, StatusIs{ status1 });
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(NumaExecutionPolicy exec, const std::string_view raw_query, DocumentStatus status1) const {
+    return FindTopDocuments(exec, raw_query, StatusIs{ status1 });
+}
+
+std::vector<Document> SearchServer::FindDocumentsPage(const std::string_view raw_query, size_t page, size_t page_size, DocumentStatus status) const {
+    return FindDocumentsPage(raw_query, page, page_size, StatusIs{ status });
+}
+
+SearchPage SearchServer::FindDocumentsAfter(const std::string_view raw_query, const std::optional<SearchCursor>& after, size_t page_size, DocumentStatus status) const {
+    return FindDocumentsAfter(raw_query, after, page_size, StatusIs{ status });
+}
+
+bool SearchServer::IsRankedBefore(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) >= EPSILON) {
+        return lhs.relevance > rhs.relevance;
+    }
+    if (lhs.rating != rhs.rating) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.id < rhs.id;
+}
+
+void SearchServer::AddToWindow(const RankWindow& window, std::vector<Document>& documents, const Document& document) {
+    if (window.after && !IsRankedBefore(*window.after, document)) {
+        return;
+    }
+    if (documents.size() < window.limit) {
+        documents.push_back(document);
+        std::push_heap(documents.begin(), documents.end(), IsRankedBefore);
+    }
+    else if (!documents.empty() && IsRankedBefore(document, documents.front())) {
+        std::pop_heap(documents.begin(), documents.end(), IsRankedBefore);
+        documents.back() = document;
+        std::push_heap(documents.begin(), documents.end(), IsRankedBefore);
+    }
+}
+
+size_t SearchServer::CountPostings(const QueryTerms& query_terms, std::optional<DocumentStatus> status) const {
+    size_t posting_count = 0;
+    for (const int term_id : query_terms.plus_terms) {
+        const PostingList& postings = term_postings_[term_id];
+        if (!status) {
+            posting_count += postings.size();
+        }
+        else if (postings.IsReleased()) {
+            posting_count += cold_postings_->GetPartitionSize(term_id, *status);
+        }
+        else {
+            posting_count += postings.GetPostings(*status).size();
+        }
+    }
+    return posting_count;
 }
 
 size_t SearchServer::GetDocumentCount() const {
-    return documents_.size();
+    return document_ordinals_.size();
 }
 
-vector_of_matched SearchServer::MatchDocument(const std::string_view raw_query, int document_id) const {
-    if (!IsValidWord(raw_query)) {
-        throw std::invalid_argument("Wrong Words"s);
+namespace {
+
+template <typename Vector>
+size_t GetVectorBytes(const Vector& values) {
+    return values.capacity() * sizeof(typename Vector::value_type);
+}
+
+//Узел std::map и std::set: значение, три указателя и цвет.
+template <typename Value>
+constexpr size_t TREE_NODE_BYTES = sizeof(Value) + 4 * sizeof(void*);
+
+//Узел std::unordered_map: значение, указатель на следующий и хэш.
+template <typename Value>
+constexpr size_t HASH_NODE_BYTES = sizeof(Value) + 2 * sizeof(void*);
+
+}
+
+MemoryStats SearchServer::GetMemoryStats(size_t top_terms) const {
+    MemoryStats stats;
+
+    stats.dictionary_bytes = term_ids_.size() * TREE_NODE_BYTES<std::pair<const std::string_view, int>>
+        + GetVectorBytes(terms_)
+        + owned_terms_.size() * sizeof(std::string) + owned_term_heap_bytes_;
+
+    stats.inverted_index_bytes = GetVectorBytes(term_postings_) + posting_allocations_->GetBytes();
+
+    stats.forward_index_bytes = GetVectorBytes(forward_terms_) + GetVectorBytes(forward_freqs_) + GetVectorBytes(forward_word_order_)
+        + GetVectorBytes(forward_positions_) + GetVectorBytes(position_bytes_);
+
+    stats.document_table_bytes = document_ordinals_.size() * TREE_NODE_BYTES<std::pair<const int, size_t>>
+        + GetVectorBytes(document_ids_) + GetVectorBytes(document_ratings_) + GetVectorBytes(document_statuses_)
+        + GetVectorBytes(document_lengths_) + GetVectorBytes(document_buffers_) + GetVectorBytes(document_fingerprints_)
+        + GetVectorBytes(forward_offsets_) + GetVectorBytes(forward_sizes_)
+        + fingerprint_documents_.size() * (HASH_NODE_BYTES<std::pair<const uint64_t, std::vector<int>>> + sizeof(int))
+        + fingerprint_documents_.bucket_count() * sizeof(void*);
+
+    stats.stop_words_bytes = stop_words_.GetMemoryBytes();
+
+    {
+        std::lock_guard<std::mutex> guard(numa_shards_mutex_);
+        if (numa_shards_) {
+            stats.numa_shard_bytes = numa_shards_->allocations->GetBytes();
+            for (const NumaPostingShard& shard : numa_shards_->shards) {
+                stats.numa_shard_bytes += GetVectorBytes(shard.term_postings);
+            }
+        }
     }
-    if (!index_.count(document_id)) {
+
+    stats.term_count = terms_.size();
+    stats.posting_count = forward_terms_.size() - forward_garbage_;
+    stats.average_posting_list_length = stats.term_count > 0 ? stats.posting_count * 1.0 / stats.term_count : 0.0;
+
+    if (top_terms > 0) {
+        std::vector<int> term_order(terms_.size());
+        std::iota(term_order.begin(), term_order.end(), 0);
+        const auto by_size = [this](int lhs, int rhs) {
+            return term_postings_[lhs].size() > term_postings_[rhs].size();
+        };
+        const size_t count = std::min(top_terms, term_order.size());
+        std::partial_sort(term_order.begin(), term_order.begin() + count, term_order.end(), by_size);
+        for (size_t i = 0; i < count; ++i) {
+            stats.largest_terms.push_back({ terms_[term_order[i]], term_postings_[term_order[i]].size() });
+        }
+    }
+    return stats;
+}
+
+uint64_t SearchServer::GetGeneration() const {
+    return generation_;
+}
+
+std::string SearchServer::NormalizeQuery(const std::string_view raw_query) const {
+    if (IsAdvancedQuery(raw_query)) {
+        return std::string(raw_query);
+    }
+    Query query = ParseQuery(raw_query);
+    for (std::vector<std::string_view>* words : { &query.plus_words, &query.minus_words }) {
+        std::sort(words->begin(), words->end());
+        words->erase(std::unique(words->begin(), words->end()), words->end());
+    }
+
+    std::string normalized;
+    for (const std::string_view word : query.plus_words) {
+        normalized += word;
+        normalized += ' ';
+    }
+    for (const std::string_view word : query.minus_words) {
+        normalized += '-';
+        normalized += word;
+        normalized += ' ';
+    }
+    if (!normalized.empty()) {
+        normalized.pop_back();
+    }
+    return normalized;
+}
+
+vector_of_matched SearchServer::MatchDocument(const std::string_view raw_query, int document_id) const {
+    const AdvancedQuery query = ParseMatchQuery(raw_query);
+    if (!HasDocument(document_id)) {
         throw std::out_of_range("Document id is out of range"s);
     }
 
-    const Query query = ParseQuery(raw_query);
     std::vector<std::string_view> matched_words;
+    const DocumentStatus status = AppendMatchedWords(query, document_id, matched_words);
+    return { matched_words, status };
+}
 
-    for (const std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+MatchedDocuments SearchServer::MatchDocuments(const std::string_view raw_query, const std::vector<int>& document_ids) const {
+    return MatchDocuments(std::execution::seq, raw_query, document_ids);
+}
+
+MatchedDocuments SearchServer::MatchDocuments(std::execution::sequenced_policy policy, const std::string_view raw_query, const std::vector<int>& document_ids) const {
+    return MatchDocumentsInChunks(ParseMatchQuery(raw_query), document_ids, 1);
+}
+
+MatchedDocuments SearchServer::MatchDocuments(std::execution::parallel_policy policy, const std::string_view raw_query, const std::vector<int>& document_ids) const {
+    const size_t worker_count = std::max(1u, std::thread::hardware_concurrency());
+    const size_t chunk_count = std::clamp<size_t>(document_ids.size() / MIN_MATCH_DOCUMENTS_PER_WORKER, 1, worker_count);
+    return MatchDocumentsInChunks(ParseMatchQuery(raw_query), document_ids, chunk_count);
+}
+
+MatchedDocuments SearchServer::MatchDocumentsInChunks(const AdvancedQuery& query, const std::vector<int>& document_ids, size_t chunk_count) const {
+    //Проверяем id заранее: исключение из параллельного алгоритма вызовет std::terminate.
+    for (const int document_id : document_ids) {
+        if (!HasDocument(document_id)) {
+            throw std::out_of_range("Document id is out of range"s);
         }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            return { matched_words, documents_.at(document_id).status };
+    }
+
+    MatchedDocuments result;
+    result.statuses.resize(document_ids.size());
+    result.offsets.assign(document_ids.size() + 1, 0);
+
+    //Каждый чанк собирает слова в свой буфер и пишет в offsets[i + 1] их количество.
+    std::vector<std::vector<std::string_view>> chunk_words(chunk_count);
+    auto match_chunk = [&](std::vector<std::string_view>& words) {
+        const size_t chunk = &words - chunk_words.data();
+        const size_t first = document_ids.size() * chunk / chunk_count;
+        const size_t last = document_ids.size() * (chunk + 1) / chunk_count;
+        for (size_t i = first; i < last; ++i) {
+            const size_t words_before = words.size();
+            result.statuses[i] = AppendMatchedWords(query, document_ids[i], words);
+            result.offsets[i + 1] = words.size() - words_before;
         }
+    };
+
+    if (chunk_count > 1) {
+        std::for_each(std::execution::par, chunk_words.begin(), chunk_words.end(), match_chunk);
+    }
+    else {
+        std::for_each(chunk_words.begin(), chunk_words.end(), match_chunk);
     }
 
-    for (const std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+    std::partial_sum(result.offsets.begin(), result.offsets.end(), result.offsets.begin());
+
+    result.words.reserve(result.offsets.back());
+    for (const std::vector<std::string_view>& words : chunk_words) {
+        result.words.insert(result.words.end(), words.begin(), words.end());
+    }
+    return result;
+}
+
+SearchServer::QueryTerms SearchServer::ResolveQueryTerms(const Query& query, PrefixExpansion plus_expansion) const {
+    QueryTerms query_terms;
+
+    auto resolve = [this](const std::vector<std::string_view>& words, PrefixExpansion expansion_mode, std::vector<int>& terms) {
+        for (const std::string_view word : words) {
+            if (IsPrefixWord(word)) {
+                ExpandPrefix(word.substr(0, word.size() - 1), expansion_mode, terms);
+                continue;
+            }
+            const auto it = term_ids_.find(word);
+            if (it != term_ids_.end()) {
+                terms.push_back(it->second);
+            }
+        }
+        std::sort(terms.begin(), terms.end());
+        terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+    };
+
+    resolve(query.plus_words, plus_expansion, query_terms.plus_terms);
+    resolve(query.minus_words, PrefixExpansion::ALL_TERMS, query_terms.minus_terms);
+    return query_terms;
+}
+
+bool SearchServer::IsPrefixWord(const std::string_view word) {
+    return word.size() > 1 && word.back() == '*';
+}
+
+void SearchServer::ExpandPrefix(const std::string_view prefix, PrefixExpansion expansion_mode, std::vector<int>& terms) const {
+    if (expansion_mode == PrefixExpansion::BEST_TERMS) {
+        std::lock_guard<std::mutex> guard(prefix_terms_mutex_);
+        if (prefix_terms_generation_ == generation_) {
+            if (const auto it = prefix_terms_.find(prefix); it != prefix_terms_.end()) {
+                terms.insert(terms.end(), it->second.begin(), it->second.end());
+                return;
+            }
+        }
+    }
+
+    //Слова с общим префиксом идут в словаре подряд.
+    std::vector<int> expansion;
+    for (auto it = term_ids_.lower_bound(prefix); it != term_ids_.end() && it->first.substr(0, prefix.size()) == prefix; ++it) {
+        if (!term_postings_[it->second].empty()) {
+            expansion.push_back(it->second);
+        }
+    }
+
+    if (expansion_mode == PrefixExpansion::BEST_TERMS && expansion.size() > MAX_PREFIX_EXPANSION) {
+        const CorpusStats corpus = GetCorpusStats();
+        DispatchRanker([&](auto ranker_tag) {
+            using Ranker = typename decltype(ranker_tag)::type;
+            std::vector<std::pair<double, int>> bounds;
+            bounds.reserve(expansion.size());
+            for (const int term_id : expansion) {
+                const PostingList& postings = term_postings_[term_id];
+                const Ranker ranker(corpus, postings.size());
+                bounds.emplace_back(ranker(postings.GetMaxTermCount(), postings.GetMinDocumentLength()), term_id);
+            }
+            std::nth_element(bounds.begin(), bounds.begin() + MAX_PREFIX_EXPANSION, bounds.end(), std::greater<>());
+            expansion.clear();
+            for (size_t i = 0; i < MAX_PREFIX_EXPANSION; ++i) {
+                expansion.push_back(bounds[i].second);
+            }
+        });
+
+        std::lock_guard<std::mutex> guard(prefix_terms_mutex_);
+        if (prefix_terms_generation_ != generation_ || prefix_terms_.size() >= MAX_CACHED_PREFIXES) {
+            prefix_terms_.clear();
+            prefix_terms_generation_ = generation_;
+        }
+        prefix_terms_.emplace(prefix, expansion);
+    }
+    terms.insert(terms.end(), expansion.begin(), expansion.end());
+}
+
+bool SearchServer::IsAdvancedQuery(const std::string_view raw_query) const {
+    if (!advanced_query_syntax_enabled_) {
+        return false;
+    }
+    return raw_query.find_first_of("\"|"sv) != raw_query.npos
+        || (!raw_query.empty() && raw_query[0] == '+')
+        || raw_query.find(" +"sv) != raw_query.npos;
+}
+
+std::optional<int> SearchServer::FindTermId(const std::string_view word) const {
+    const auto it = term_ids_.find(word);
+    if (it == term_ids_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+SearchServer::AdvancedQuery SearchServer::ParseAdvancedQuery(std::string_view text, PrefixExpansion plus_expansion) const {
+    if (!IsValidWord(text)) {
+        throw std::invalid_argument("Спец символ в запросе"s);
+    }
+    AdvancedQuery query;
+
+    while (true) {
+        text.remove_prefix(std::min(text.find_first_not_of(' '), text.size()));
+        if (text.empty()) {
+            break;
+        }
+
+        if (text[0] == '"') {
+            const size_t close = text.find('"', 1);
+            if (close == text.npos) {
+                throw std::invalid_argument("незакрытая кавычка"s);
+            }
+            AddPhrase(text.substr(1, close - 1), query);
+            text.remove_prefix(close + 1);
             continue;
         }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.push_back(word);
+
+        const std::string_view token = text.substr(0, text.find(' '));
+        text.remove_prefix(token.size());
+
+        if (token[0] == '+') {
+            const std::string_view word = token.substr(1);
+            if (word.empty() || word[0] == '-' || word[0] == '+') {
+                throw std::invalid_argument("неверное обязательное слово"s);
+            }
+            if (IsStopWord(word)) {
+                continue;
+            }
+            //+dog* требует хотя бы одно слово под префиксом: это группа ИЛИ из всех таких слов.
+            if (IsPrefixWord(word)) {
+                const std::string_view prefix = word.substr(0, word.size() - 1);
+                std::vector<int> group;
+                ExpandPrefix(prefix, PrefixExpansion::ALL_TERMS, group);
+                if (group.empty()) {
+                    query.is_empty_result = true;
+                    continue;
+                }
+                ExpandPrefix(prefix, plus_expansion, query.scored_terms);
+                std::sort(group.begin(), group.end());
+                query.any_of_groups.push_back(std::move(group));
+                continue;
+            }
+            const std::optional<int> term_id = FindTermId(word);
+            if (!term_id) {
+                query.is_empty_result = true;
+                continue;
+            }
+            query.required_terms.push_back(*term_id);
+            query.scored_terms.push_back(*term_id);
+        }
+        else if (token.find('|') != token.npos) {
+            std::vector<int> group;
+            bool has_words = false;
+            for (std::string_view rest = token; !rest.empty();) {
+                const std::string_view word = rest.substr(0, rest.find('|'));
+                rest.remove_prefix(std::min(word.size() + 1, rest.size()));
+                if (word.empty() || IsStopWord(word)) {
+                    continue;
+                }
+                has_words = true;
+                if (IsPrefixWord(word)) {
+                    const std::string_view prefix = word.substr(0, word.size() - 1);
+                    ExpandPrefix(prefix, PrefixExpansion::ALL_TERMS, group);
+                    ExpandPrefix(prefix, plus_expansion, query.scored_terms);
+                }
+                else if (const std::optional<int> term_id = FindTermId(word)) {
+                    group.push_back(*term_id);
+                    query.scored_terms.push_back(*term_id);
+                }
+            }
+            if (!has_words) {
+                continue;
+            }
+            if (group.empty()) {
+                query.is_empty_result = true;
+                continue;
+            }
+            std::sort(group.begin(), group.end());
+            group.erase(std::unique(group.begin(), group.end()), group.end());
+            query.any_of_groups.push_back(std::move(group));
+        }
+        else {
+            const QueryWord query_word = ParseQueryWord(token);
+            if (query_word.is_stop) {
+                continue;
+            }
+            std::vector<int>& terms = query_word.is_minus ? query.minus_terms : query.scored_terms;
+            if (IsPrefixWord(query_word.data)) {
+                const PrefixExpansion expansion_mode = query_word.is_minus ? PrefixExpansion::ALL_TERMS : plus_expansion;
+                ExpandPrefix(query_word.data.substr(0, query_word.data.size() - 1), expansion_mode, terms);
+            }
+            else if (const std::optional<int> term_id = FindTermId(query_word.data)) {
+                terms.push_back(*term_id);
+            }
+        }
+    }
+
+    for (std::vector<int>* terms : { &query.required_terms, &query.scored_terms, &query.minus_terms }) {
+        std::sort(terms->begin(), terms->end());
+        terms->erase(std::unique(terms->begin(), terms->end()), terms->end());
+    }
+    return query;
+}
+
+void SearchServer::AddPhrase(const std::string_view text, AdvancedQuery& query) const {
+    std::vector<PhraseWord> phrase;
+    uint32_t offset = 0;
+    for (const std::string_view word : SplitIntoWords(text)) {
+        if (!IsStopWord(word)) {
+            const std::optional<int> term_id = FindTermId(word);
+            if (!term_id) {
+                query.is_empty_result = true;
+                return;
+            }
+            phrase.push_back({ *term_id, offset });
+        }
+        ++offset;
+    }
+    if (phrase.empty()) {
+        return;
+    }
+
+    for (const PhraseWord& word : phrase) {
+        query.scored_terms.push_back(word.term_id);
+    }
+    if (phrase.size() == 1) {
+        query.required_terms.push_back(phrase.front().term_id);
+        return;
+    }
+    if (!positional_index_enabled_) {
+        throw std::logic_error("phrase queries require positional index"s);
+    }
+
+    const uint32_t first_offset = phrase.front().offset;
+    for (PhraseWord& word : phrase) {
+        word.offset -= first_offset;
+    }
+    query.phrases.push_back(std::move(phrase));
+}
+
+std::vector<int> SearchServer::FindAdvancedCandidates(const AdvancedQuery& query, DocumentStatus partition) const {
+    const auto posting_less = [](const Posting& posting, int document_id) {
+        return posting.document_id < document_id;
+    };
+
+    std::vector<std::shared_ptr<const PostingList>> held_lists;
+    std::vector<const PostingVector*> term_lists;
+    for (const int term_id : query.required_terms) {
+        term_lists.push_back(&held_lists.emplace_back(GetTermPostings(term_id))->GetPostings(partition));
+    }
+    for (const std::vector<PhraseWord>& phrase : query.phrases) {
+        for (const PhraseWord& word : phrase) {
+            term_lists.push_back(&held_lists.emplace_back(GetTermPostings(word.term_id))->GetPostings(partition));
+        }
+    }
+
+    std::vector<std::vector<int>> group_lists;
+    for (const std::vector<int>& group : query.any_of_groups) {
+        std::vector<int> document_ids;
+        for (const int term_id : group) {
+            const std::shared_ptr<const PostingList> postings = GetTermPostings(term_id);
+            for (const Posting& posting : postings->GetPostings(partition)) {
+                document_ids.push_back(posting.document_id);
+            }
+        }
+        std::sort(document_ids.begin(), document_ids.end());
+        document_ids.erase(std::unique(document_ids.begin(), document_ids.end()), document_ids.end());
+        group_lists.push_back(std::move(document_ids));
+    }
+
+    //Начинаем с самого короткого списка, остальные проверяем галопирующим поиском.
+    std::sort(term_lists.begin(), term_lists.end(), [](const auto* lhs, const auto* rhs) {
+        return lhs->size() < rhs->size();
+    });
+    std::sort(group_lists.begin(), group_lists.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.size() < rhs.size();
+    });
+
+    std::vector<int> candidates;
+    size_t first_term_list = 0;
+    size_t first_group_list = 0;
+    if (!term_lists.empty() && (group_lists.empty() || term_lists.front()->size() <= group_lists.front().size())) {
+        for (const Posting& posting : *term_lists.front()) {
+            candidates.push_back(posting.document_id);
+        }
+        first_term_list = 1;
+    }
+    else if (!group_lists.empty()) {
+        candidates = std::move(group_lists.front());
+        first_group_list = 1;
+    }
+
+    for (size_t i = first_term_list; i < term_lists.size() && !candidates.empty(); ++i) {
+        const PostingVector& postings = *term_lists[i];
+        auto posting_it = postings.begin();
+        candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&](int document_id) {
+            posting_it = GallopingLowerBound(posting_it, postings.end(), document_id, posting_less);
+            return posting_it == postings.end() || posting_it->document_id != document_id;
+        }), candidates.end());
+    }
+    for (size_t i = first_group_list; i < group_lists.size() && !candidates.empty(); ++i) {
+        const std::vector<int>& document_ids = group_lists[i];
+        auto id_it = document_ids.begin();
+        candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&](int document_id) {
+            id_it = GallopingLowerBound(id_it, document_ids.end(), document_id);
+            return id_it == document_ids.end() || *id_it != document_id;
+        }), candidates.end());
+    }
+    return candidates;
+}
+
+bool SearchServer::ContainsPhrases(const AdvancedQuery& query, size_t ordinal) const {
+    const int* terms_begin = ForwardTermsBegin(ordinal);
+    const int* terms_end = ForwardTermsEnd(ordinal);
+
+    for (const std::vector<PhraseWord>& phrase : query.phrases) {
+        std::vector<std::pair<std::vector<uint32_t>, uint32_t>> phrase_positions;
+        for (const PhraseWord& word : phrase) {
+            const int* term_it = GallopingLowerBound(terms_begin, terms_end, word.term_id);
+            if (term_it == terms_end || *term_it != word.term_id) {
+                return false;
+            }
+            const size_t entry = term_it - forward_terms_.data();
+            phrase_positions.emplace_back(DecodePositions(position_bytes_.data() + forward_positions_[entry]), word.offset);
+        }
+        if (!ContainsPhrase(phrase_positions)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool SearchServer::SatisfiesConstraints(const AdvancedQuery& query, size_t ordinal) const {
+    if (query.is_empty_result) {
+        return false;
+    }
+    const int* terms_begin = ForwardTermsBegin(ordinal);
+    const int* terms_end = ForwardTermsEnd(ordinal);
+    const auto contains = [terms_begin, terms_end](int term_id) {
+        return std::binary_search(terms_begin, terms_end, term_id);
+    };
+
+    if (!std::all_of(query.required_terms.begin(), query.required_terms.end(), contains)) {
+        return false;
+    }
+    for (const std::vector<int>& group : query.any_of_groups) {
+        if (!std::any_of(group.begin(), group.end(), contains)) {
+            return false;
         }
     }
-    
-    return { matched_words, documents_.at(document_id).status };
+    return ContainsPhrases(query, ordinal);
+}
+
+SearchServer::AdvancedQuery SearchServer::ParseMatchQuery(const std::string_view raw_query) const {
+    if (IsAdvancedQuery(raw_query)) {
+        return ParseAdvancedQuery(raw_query, PrefixExpansion::ALL_TERMS);
+    }
+    QueryTerms query_terms = ResolveQueryTerms(ParseQuery(raw_query), PrefixExpansion::ALL_TERMS);
+    AdvancedQuery query;
+    query.scored_terms = std::move(query_terms.plus_terms);
+    query.minus_terms = std::move(query_terms.minus_terms);
+    return query;
+}
+
+DocumentStatus SearchServer::AppendMatchedWords(const AdvancedQuery& query, int document_id, std::vector<std::string_view>& matched_words) const {
+    const size_t ordinal = GetDocumentOrdinal(document_id);
+    const int* terms_begin = ForwardTermsBegin(ordinal);
+    const int* terms_end = ForwardTermsEnd(ordinal);
+
+    //Минус-слова проверяем первыми: при совпадении пересечение не нужно.
+    const int* document_it = terms_begin;
+    for (const int term_id : query.minus_terms) {
+        document_it = GallopingLowerBound(document_it, terms_end, term_id);
+        if (document_it == terms_end) {
+            break;
+        }
+        if (*document_it == term_id) {
+            return document_statuses_[ordinal];
+        }
+    }
+    if (query.HasConstraints() && !SatisfiesConstraints(query, ordinal)) {
+        return document_statuses_[ordinal];
+    }
+
+    const size_t words_before = matched_words.size();
+    ForEachIntersection(query.scored_terms.begin(), query.scored_terms.end(),
+        terms_begin, terms_end,
+        [this, &matched_words](auto query_it, auto) {
+            matched_words.push_back(terms_[*query_it]);
+        });
+
+    std::sort(matched_words.begin() + words_before, matched_words.end());
+    return document_statuses_[ordinal];
 }
 
 
 bool SearchServer::IsStopWord(const std::string_view word) const {
-    return stop_words_.count(word) > 0;
+    return stop_words_.Contains(word);
 }
 
-std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(const std::string_view& text){
-    std::vector<std::string_view> words;
+std::vector<int> SearchServer::SplitIntoWordsNoStop(const std::string_view& text, std::vector<uint32_t>* positions, SharedBuffer* buffer){
+    std::vector<int> term_ids;
 
+    //Позиция считается среди всех слов, включая стоп-слова, чтобы фраза
+    //"big dog" не находилась в тексте "big and dog".
+    uint32_t position = 0;
     for (const std::string_view word : SplitIntoWords(text)) {
 
         if (!IsStopWord(word)) {
-            if (string_set_.count(word)) {
-                words.push_back(*string_set_.find(word));
-            }
-            else {
-                auto res = string_set_.insert(std::string{ word.begin(), word.end() });
-                words.push_back(*res.first);
+            term_ids.push_back(GetOrAddTermId(word, buffer));
+            if (positions) {
+                positions->push_back(position);
             }
         }
+        ++position;
     }
-    return words;
+    return term_ids;
+}
+
+int SearchServer::GetOrAddTermId(const std::string_view word, SharedBuffer* buffer) {
+    const auto it = term_ids_.find(word);
+    if (it != term_ids_.end()) {
+        return it->second;
+    }
+    const int term_id = static_cast<int>(terms_.size());
+    std::string_view key = word;
+    if (buffer != nullptr) {
+        buffer->anchored_terms.push_back(term_id);
+    }
+    else {
+        key = AddOwnedTerm(word);
+    }
+    term_ids_.emplace(key, term_id);
+    terms_.push_back(key);
+    term_postings_.emplace_back(posting_allocations_.get());
+    term_reads_.emplace_back(0);
+    return term_id;
+}
+
+std::string_view SearchServer::AddOwnedTerm(const std::string_view word) {
+    const std::string& term = owned_terms_.emplace_back(word);
+    if (term.capacity() > std::string().capacity()) {
+        owned_term_heap_bytes_ += term.capacity() + 1;
+    }
+    return term;
+}
+
+void SearchServer::RetireSharedBuffer(const void* buffer_key) {
+    const auto buffer_it = shared_buffers_.find(buffer_key);
+    for (const int term_id : buffer_it->second.anchored_terms) {
+        //Содержимое ключа не меняется, поэтому узел возвращается на то же место в порядке.
+        auto node = term_ids_.extract(terms_[term_id]);
+        const std::string_view key = AddOwnedTerm(terms_[term_id]);
+        node.key() = key;
+        term_ids_.insert(std::move(node));
+        terms_[term_id] = key;
+    }
+    shared_buffers_.erase(buffer_it);
 }
 
 int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
@@ -130,7 +933,7 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) cons
     return { text, is_minus, IsStopWord(text) };
 }
 
-SearchServer::Query SearchServer::ParseQuery(const std::string_view text, bool is_for_par) const {
+SearchServer::Query SearchServer::ParseQuery(const std::string_view text) const {
     if (!IsValidWord(text)) {
         throw std::invalid_argument("Спец символ в минус запросе"s);
     }
@@ -148,15 +951,6 @@ SearchServer::Query SearchServer::ParseQuery(const std::string_view text, bool i
         }
     }
 
-    if (!is_for_par)
-    {
-        std::sort(query.plus_words.begin(), query.plus_words.end());
-        query.plus_words.erase(std::unique(query.plus_words.begin(), query.plus_words.end()), query.plus_words.end());
-
-        std::sort(query.minus_words.begin(), query.minus_words.begin());
-        query.minus_words.erase(std::unique(query.minus_words.begin(), query.minus_words.end()), query.minus_words.end());
-    }
-
     return query;
 }
 
@@ -167,76 +961,455 @@ bool SearchServer::IsValidWord(const std::string_view word) {
         });
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view word) const {
-    return std::log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+CorpusStats SearchServer::GetCorpusStats() const {
+    const size_t document_count = GetDocumentCount();
+    return { document_count, document_count > 0 ? total_document_length_ * 1.0 / document_count : 0.0 };
+}
+
+double SearchServer::FindKthRelevance(const std::map<int, DocumentRelevance>& document_to_relevance, size_t k) {
+    std::vector<double> relevances;
+    relevances.reserve(document_to_relevance.size());
+    for (const auto& [document_id, document] : document_to_relevance) {
+        relevances.push_back(document.relevance);
+    }
+    return FindKthRelevance(relevances, k);
+}
+
+double SearchServer::FindKthRelevance(std::vector<double>& relevances, size_t k) {
+    std::nth_element(relevances.begin(), relevances.begin() + (k - 1), relevances.end(), std::greater<>());
+    return relevances[k - 1];
+}
+
+const RoaringBitmap& SearchServer::GetDocumentsWithStatus(DocumentStatus status) const {
+    return status_documents_[static_cast<size_t>(status)];
 }
 
-const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-    const static std::map<std::string_view, double> emptymap;
-    return (documents_word_freqs_.count(document_id) ? documents_word_freqs_.at(document_id) : emptymap);
+std::shared_ptr<const RoaringBitmap> SearchServer::GetTermBitmap(int term_id) const {
+    const PostingList& postings = term_postings_[term_id];
+    const bool is_cached = postings.size() >= MIN_CACHED_BITMAP_POSTINGS;
+    if (is_cached) {
+        std::lock_guard<std::mutex> guard(term_bitmaps_mutex_);
+        const auto it = term_bitmaps_.find(term_id);
+        if (it != term_bitmaps_.end()) {
+            return it->second;
+        }
+    }
+
+    const std::shared_ptr<const PostingList> term_postings = GetTermPostings(term_id);
+    auto bitmap = std::make_shared<RoaringBitmap>();
+    for (const DocumentStatus status : ALL_DOCUMENT_STATUSES) {
+        for (const Posting& posting : term_postings->GetPostings(status)) {
+            bitmap->Add(posting.document_id);
+        }
+    }
+
+    if (is_cached) {
+        std::lock_guard<std::mutex> guard(term_bitmaps_mutex_);
+        term_bitmaps_.emplace(term_id, bitmap);
+    }
+    return bitmap;
+}
+
+std::shared_ptr<const RoaringBitmap> SearchServer::BuildExcludedDocuments(const QueryTerms& query_terms) const {
+    std::vector<int> minus_terms;
+    for (const int term_id : query_terms.minus_terms) {
+        if (!term_postings_[term_id].empty()) {
+            minus_terms.push_back(term_id);
+        }
+    }
+    if (minus_terms.empty()) {
+        return nullptr;
+    }
+    if (minus_terms.size() == 1) {
+        return GetTermBitmap(minus_terms.front());
+    }
+
+    auto excluded = std::make_shared<RoaringBitmap>();
+    for (const int term_id : minus_terms) {
+        excluded->UnionWith(*GetTermBitmap(term_id));
+    }
+    return excluded;
+}
+
+void SearchServer::InvalidateTermBitmaps(const int* terms_begin, const int* terms_end) {
+    std::lock_guard<std::mutex> guard(term_bitmaps_mutex_);
+    if (term_bitmaps_.empty()) {
+        return;
+    }
+    for (const int* term_it = terms_begin; term_it != terms_end; ++term_it) {
+        term_bitmaps_.erase(*term_it);
+    }
+}
+
+WordFrequencies SearchServer::GetWordFrequencies(int document_id) const {
+    if (!HasDocument(document_id)) {
+        return {};
+    }
+    const size_t ordinal = GetDocumentOrdinal(document_id);
+    const size_t offset = forward_offsets_[ordinal];
+    return { ForwardTermsBegin(ordinal), forward_freqs_.data() + offset, forward_word_order_.data() + offset, forward_sizes_[ordinal], terms_ };
 }
 
 void SearchServer::RemoveDocument(int document_id) {
+    RemoveDocument(std::execution::seq, document_id);
+}
 
-    if (documents_word_freqs_.count(document_id)) {
-        documents_.erase(document_id);
-        index_.erase(find(index_.begin(), index_.end(), document_id));
+void SearchServer::EraseDocumentData(int document_id) {
+    const size_t ordinal = GetDocumentOrdinal(document_id);
 
-        for (const auto& [word, freq] : documents_word_freqs_[document_id]) {
-            word_to_document_freqs_[word].erase(document_id);
+    InvalidateTermBitmaps(ForwardTermsBegin(ordinal), ForwardTermsEnd(ordinal));
+    ++generation_;
+    status_documents_[static_cast<size_t>(document_statuses_[ordinal])].Remove(document_id);
+    forward_garbage_ += forward_sizes_[ordinal];
+    total_document_length_ -= document_lengths_[ordinal];
+    {
+        const auto group_it = fingerprint_documents_.find(document_fingerprints_[ordinal]);
+        std::vector<int>& group = group_it->second;
+        group.erase(std::find(group.begin(), group.end(), document_id));
+        if (group.empty()) {
+            fingerprint_documents_.erase(group_it);
+        }
+    }
+    if (const void* buffer_key = document_buffers_[ordinal]; buffer_key != nullptr && --shared_buffers_.at(buffer_key).document_count == 0) {
+        RetireSharedBuffer(buffer_key);
+    }
 
-            if (!word_to_document_freqs_[word].size()) {
-                word_to_document_freqs_.erase(word);
-            }
+    //Переносим последнюю строку таблицы на место удалённой.
+    const size_t last = document_ids_.size() - 1;
+    if (ordinal != last) {
+        document_ids_[ordinal] = document_ids_[last];
+        document_ratings_[ordinal] = document_ratings_[last];
+        document_statuses_[ordinal] = document_statuses_[last];
+        document_lengths_[ordinal] = document_lengths_[last];
+        document_buffers_[ordinal] = document_buffers_[last];
+        document_fingerprints_[ordinal] = document_fingerprints_[last];
+        forward_offsets_[ordinal] = forward_offsets_[last];
+        forward_sizes_[ordinal] = forward_sizes_[last];
+        document_ordinals_[document_ids_[ordinal]] = ordinal;
+    }
+    document_ids_.pop_back();
+    document_ratings_.pop_back();
+    document_statuses_.pop_back();
+    document_lengths_.pop_back();
+    document_buffers_.pop_back();
+    document_fingerprints_.pop_back();
+    forward_offsets_.pop_back();
+    forward_sizes_.pop_back();
+    document_ordinals_.erase(document_id);
+
+    if (forward_garbage_ * 2 > forward_terms_.size()) {
+        CompactForwardIndex();
+    }
+}
+
+void SearchServer::Rebuild() {
+    Rebuild(std::execution::seq);
+}
+
+void SearchServer::MovePostingsToDisk(const std::string& path, const PostingTierOptions& options) {
+    LoadColdPostings();
+
+    //Сначала самые читаемые слова, при равенстве - короткие списки.
+    std::vector<int> term_order;
+    for (int term_id = 0; term_id < static_cast<int>(term_postings_.size()); ++term_id) {
+        if (!term_postings_[term_id].empty()) {
+            term_order.push_back(term_id);
         }
+    }
+    std::sort(term_order.begin(), term_order.end(), [this](int lhs, int rhs) {
+        const uint32_t lhs_reads = term_reads_[lhs].load(std::memory_order_relaxed);
+        const uint32_t rhs_reads = term_reads_[rhs].load(std::memory_order_relaxed);
+        if (lhs_reads != rhs_reads) {
+            return lhs_reads > rhs_reads;
+        }
+        return term_postings_[lhs].size() < term_postings_[rhs].size();
+    });
 
-        documents_word_freqs_.erase(document_id);
+    std::vector<int> cold_terms;
+    size_t resident_bytes = 0;
+    for (const int term_id : term_order) {
+        const size_t bytes = term_postings_[term_id].GetMemoryBytes();
+        if (resident_bytes + bytes <= options.resident_bytes) {
+            resident_bytes += bytes;
+        }
+        else {
+            cold_terms.push_back(term_id);
+        }
+    }
 
+    //Списки освобождаются только после того, как все записаны: ошибка записи
+    //оставляет индекс целиком в памяти.
+    auto store = std::make_unique<ColdPostingStore>(path, options.cache_bytes);
+    for (const int term_id : cold_terms) {
+        store->Write(term_id, term_postings_[term_id]);
+    }
+    for (const int term_id : cold_terms) {
+        term_postings_[term_id].Release();
     }
+    cold_postings_ = std::move(store);
 }
 
-vector_of_matched SearchServer::MatchDocument(std::execution::sequenced_policy exec, const std::string_view raw_query, int document_id) const {
-    return MatchDocument(raw_query, document_id);
+void SearchServer::EnableTermReadCounting(bool is_enabled) {
+    term_read_counting_enabled_ = is_enabled;
 }
 
+std::optional<ColdPostingStats> SearchServer::GetColdPostingStats() const {
+    if (!cold_postings_) {
+        return std::nullopt;
+    }
+    return cold_postings_->GetStats();
+}
 
-vector_of_matched SearchServer::MatchDocument(std::execution::parallel_policy exec, const std::string_view raw_query, int document_id) const {
-    if (!IsValidWord(raw_query)) {
-        throw std::invalid_argument("Wrong Words"s);
+std::shared_ptr<const PostingList> SearchServer::GetTermPostings(int term_id) const {
+    if (term_read_counting_enabled_) {
+        term_reads_[term_id].fetch_add(1, std::memory_order_relaxed);
     }
-    if (!index_.count(document_id)) {
-        throw std::out_of_range("Document id is out of range"s);
+    const PostingList& postings = term_postings_[term_id];
+    if (postings.IsReleased()) {
+        return cold_postings_->Read(term_id);
     }
+    //Горячий список не копируется: указатель без владельца.
+    return std::shared_ptr<const PostingList>(std::shared_ptr<const PostingList>(), &postings);
+}
 
-    Query query = ParseQuery(raw_query, true);
+Posting SearchServer::MakePosting(size_t ordinal, size_t i) const {
+    const uint32_t term_count = static_cast<uint32_t>(std::lround(forward_freqs_[i] * document_lengths_[ordinal]));
+    return { document_ids_[ordinal], document_ratings_[ordinal], term_count, document_lengths_[ordinal] };
+}
 
-    if (std::any_of(std::execution::par, query.minus_words.begin(), query.minus_words.end(),
-        [&](std::string_view word) {
-            if (word_to_document_freqs_.count(word) != 0) {
-                return (word_to_document_freqs_.at(word).count(document_id) != 0);
-            }
-            return false;
-        }))
+std::shared_ptr<const SearchServer::NumaPostingShards> SearchServer::GetNumaPostingShards(PinnedWorkerPool& pool) const {
+    std::vector<int> worker_nodes(pool.GetWorkerCount());
+    for (size_t worker = 0; worker < worker_nodes.size(); ++worker) {
+        worker_nodes[worker] = pool.GetWorkerNode(worker);
+    }
+    if (std::adjacent_find(worker_nodes.begin(), worker_nodes.end(), std::not_equal_to<>()) == worker_nodes.end()) {
+        return nullptr;
+    }
     {
-        return { std::vector<std::string_view>{}, documents_.at(document_id).status };
+        std::lock_guard<std::mutex> guard(numa_shards_mutex_);
+        if (numa_shards_ && numa_shards_->generation == generation_ && numa_shards_->worker_nodes == worker_nodes) {
+            return numa_shards_;
+        }
     }
 
-    std::vector<std::string_view> matched_words(query.plus_words.size());
+    //Строим без блокировки: пул может быть занят запросом, который сам ждёт шарды.
+    auto numa_shards = std::make_shared<NumaPostingShards>();
+    numa_shards->generation = generation_;
+    numa_shards->cold_terms.resize(term_postings_.size());
+    for (size_t term_id = 0; term_id < term_postings_.size(); ++term_id) {
+        numa_shards->cold_terms[term_id] = term_postings_[term_id].IsReleased();
+    }
+    for (size_t worker = 0; worker < worker_nodes.size(); ++worker) {
+        if (worker == 0 || worker_nodes[worker] != worker_nodes[worker - 1]) {
+            numa_shards->shards.push_back({ worker, {} });
+        }
+    }
 
-    auto last = std::copy_if(std::execution::par,
-        query.plus_words.begin(), query.plus_words.end(),
-        matched_words.begin(),
-        [&](std::string_view word) {
-            if (word_to_document_freqs_.count(word) != 0) {
-                return word_to_document_freqs_.at(word).count(document_id) != 0;
+    //Узел получает долю документов по числу своих потоков.
+    std::vector<size_t> ordinals;
+    ordinals.reserve(document_ordinals_.size());
+    for (const auto& [document_id, ordinal] : document_ordinals_) {
+        ordinals.push_back(ordinal);
+    }
+    const size_t worker_count = worker_nodes.size();
+    pool.Run([&](size_t worker) {
+        for (size_t node = 0; node < numa_shards->shards.size(); ++node) {
+            NumaPostingShard& shard = numa_shards->shards[node];
+            if (shard.first_worker != worker) {
+                continue;
             }
-            return false;
+            const size_t last_worker = node + 1 < numa_shards->shards.size() ? numa_shards->shards[node + 1].first_worker : worker_count;
+            const std::vector<size_t> node_ordinals(ordinals.begin() + ordinals.size() * shard.first_worker / worker_count,
+                ordinals.begin() + ordinals.size() * last_worker / worker_count);
+            shard.term_postings = BuildPostingShard(node_ordinals, numa_shards->cold_terms, numa_shards->allocations.get());
         }
-    );
+    });
+    numa_shards->worker_nodes = std::move(worker_nodes);
 
-    matched_words.erase(last, matched_words.end());
+    std::lock_guard<std::mutex> guard(numa_shards_mutex_);
+    numa_shards_ = numa_shards;
+    return numa_shards;
+}
 
-    std::sort(std::execution::par, matched_words.begin(), matched_words.end());
-    matched_words.erase(std::unique(std::execution::par, matched_words.begin(), matched_words.end()), matched_words.end());
-    return { matched_words, documents_.at(document_id).status };
+std::vector<PostingList> SearchServer::BuildPostingShard(const std::vector<size_t>& ordinals, const std::vector<bool>& skipped_terms, AllocationCounter* counter) const {
+    const auto bucket_of = [](int term_id, DocumentStatus status) {
+        return static_cast<size_t>(term_id) * DOCUMENT_STATUS_COUNT + static_cast<size_t>(status);
+    };
+    std::vector<uint32_t> counts(terms_.size() * DOCUMENT_STATUS_COUNT, 0);
+    for (const size_t ordinal : ordinals) {
+        for (const int* term_it = ForwardTermsBegin(ordinal); term_it != ForwardTermsEnd(ordinal); ++term_it) {
+            if (!skipped_terms[*term_it]) {
+                ++counts[bucket_of(*term_it, document_statuses_[ordinal])];
+            }
+        }
+    }
+
+    std::vector<PostingList> term_postings(terms_.size(), PostingList(counter));
+    std::vector<Posting*> partitions(counts.size());
+    for (int term_id = 0; term_id < static_cast<int>(terms_.size()); ++term_id) {
+        for (const DocumentStatus status : ALL_DOCUMENT_STATUSES) {
+            const size_t bucket = bucket_of(term_id, status);
+            partitions[bucket] = term_postings[term_id].ResizePartition(status, counts[bucket]);
+        }
+    }
+    for (const size_t ordinal : ordinals) {
+        const size_t offset = forward_offsets_[ordinal];
+        for (size_t i = offset; i < offset + forward_sizes_[ordinal]; ++i) {
+            if (!skipped_terms[forward_terms_[i]]) {
+                *partitions[bucket_of(forward_terms_[i], document_statuses_[ordinal])]++ = MakePosting(ordinal, i);
+            }
+        }
+    }
+    for (PostingList& postings : term_postings) {
+        postings.Seal();
+    }
+    return term_postings;
+}
+
+PostingList& SearchServer::GetMutablePostings(int term_id) {
+    PostingList& postings = term_postings_[term_id];
+    if (postings.IsReleased()) {
+        postings = cold_postings_->Take(term_id, posting_allocations_.get());
+    }
+    return postings;
+}
+
+void SearchServer::LoadColdPostings() {
+    if (!cold_postings_) {
+        return;
+    }
+    for (int term_id = 0; term_id < static_cast<int>(term_postings_.size()); ++term_id) {
+        GetMutablePostings(term_id);
+    }
+    cold_postings_.reset();
+}
+
+void SearchServer::SortWordOrder(size_t ordinal) {
+    const int* document_terms = ForwardTermsBegin(ordinal);
+    uint32_t* order_begin = forward_word_order_.data() + forward_offsets_[ordinal];
+    uint32_t* order_end = order_begin + forward_sizes_[ordinal];
+    std::iota(order_begin, order_end, 0);
+    std::sort(order_begin, order_end, [this, document_terms](uint32_t lhs, uint32_t rhs) {
+        return terms_[document_terms[lhs]] < terms_[document_terms[rhs]];
+    });
+}
+
+void SearchServer::ReplaceStopWords(StopWordSet stop_words) {
+    for (const std::string_view word : stop_words_.GetWords()) {
+        if (!stop_words.Contains(word)) {
+            throw std::invalid_argument("stop words can only be added: document texts are not stored"s);
+        }
+    }
+    stop_words_ = std::move(stop_words);
+
+    std::vector<bool> dropped_terms(terms_.size());
+    bool has_dropped_terms = false;
+    for (size_t term_id = 0; term_id < terms_.size(); ++term_id) {
+        if (stop_words_.Contains(terms_[term_id])) {
+            dropped_terms[term_id] = true;
+            has_dropped_terms = true;
+        }
+    }
+    if (!has_dropped_terms) {
+        return;
+    }
+    CompactForwardIndex(&dropped_terms);
+
+    //Наборы слов документов изменились, отпечатки считаются заново.
+    fingerprint_documents_.clear();
+    for (const auto& [document_id, ordinal] : document_ordinals_) {
+        const uint64_t fingerprint = ComputeFingerprint({ ForwardTermsBegin(ordinal), ForwardTermsEnd(ordinal) });
+        document_fingerprints_[ordinal] = fingerprint;
+        fingerprint_documents_[fingerprint].push_back(document_id);
+    }
+}
+
+void SearchServer::CompactForwardIndex(const std::vector<bool>* dropped_terms) {
+    const size_t live_size = forward_terms_.size() - forward_garbage_;
+    std::vector<int> compacted_terms;
+    std::vector<double> compacted_freqs;
+    std::vector<uint32_t> compacted_word_order;
+    std::vector<size_t> compacted_positions;
+    std::vector<uint8_t> compacted_bytes;
+    compacted_terms.reserve(live_size);
+    compacted_freqs.reserve(live_size);
+    compacted_word_order.reserve(live_size);
+    if (positional_index_enabled_) {
+        compacted_positions.reserve(live_size);
+    }
+
+    std::vector<size_t> changed_ordinals;
+    for (size_t ordinal = 0; ordinal < document_ids_.size(); ++ordinal) {
+        const size_t offset = forward_offsets_[ordinal];
+        const size_t compacted_offset = compacted_terms.size();
+        const uint32_t length = document_lengths_[ordinal];
+        uint32_t dropped_length = 0;
+        forward_offsets_[ordinal] = compacted_offset;
+        for (size_t i = offset; i < offset + forward_sizes_[ordinal]; ++i) {
+            if (dropped_terms != nullptr && (*dropped_terms)[forward_terms_[i]]) {
+                dropped_length += static_cast<uint32_t>(std::lround(forward_freqs_[i] * length));
+                continue;
+            }
+            compacted_terms.push_back(forward_terms_[i]);
+            compacted_freqs.push_back(forward_freqs_[i]);
+            compacted_word_order.push_back(forward_word_order_[i]);
+            if (positional_index_enabled_) {
+                const uint8_t* positions_begin = position_bytes_.data() + forward_positions_[i];
+                compacted_positions.push_back(compacted_bytes.size());
+                compacted_bytes.insert(compacted_bytes.end(), positions_begin, SkipPositions(positions_begin));
+            }
+        }
+        if (dropped_length == 0) {
+            continue;
+        }
+        //Частота - доля слова в документе, а длина документа уменьшилась.
+        const uint32_t new_length = length - dropped_length;
+        for (size_t i = compacted_offset; i < compacted_terms.size(); ++i) {
+            compacted_freqs[i] = std::lround(compacted_freqs[i] * length) / static_cast<double>(new_length);
+        }
+        forward_sizes_[ordinal] = static_cast<uint32_t>(compacted_terms.size() - compacted_offset);
+        document_lengths_[ordinal] = new_length;
+        total_document_length_ -= dropped_length;
+        changed_ordinals.push_back(ordinal);
+    }
+
+    forward_terms_ = std::move(compacted_terms);
+    forward_freqs_ = std::move(compacted_freqs);
+    forward_word_order_ = std::move(compacted_word_order);
+    forward_positions_ = std::move(compacted_positions);
+    position_bytes_ = std::move(compacted_bytes);
+    forward_garbage_ = 0;
+    for (const size_t ordinal : changed_ordinals) {
+        SortWordOrder(ordinal);
+    }
+}
+
+bool SearchServer::HasDocument(int document_id) const {
+    return document_ordinals_.count(document_id) > 0;
+}
+
+size_t SearchServer::GetDocumentOrdinal(int document_id) const {
+    return document_ordinals_.at(document_id);
+}
+
+const int* SearchServer::ForwardTermsBegin(size_t ordinal) const {
+    return forward_terms_.data() + forward_offsets_[ordinal];
+}
+
+const int* SearchServer::ForwardTermsEnd(size_t ordinal) const {
+    return ForwardTermsBegin(ordinal) + forward_sizes_[ordinal];
+}
+
+vector_of_matched SearchServer::MatchDocument(std::execution::sequenced_policy exec, const std::string_view raw_query, int document_id) const {
+    return MatchDocument(raw_query, document_id);
+}
+
+
+vector_of_matched SearchServer::MatchDocument(std::execution::parallel_policy exec, const std::string_view raw_query, int document_id) const {
+    //Пересечение с прямым индексом дешевле запуска параллельных алгоритмов.
+    return MatchDocument(raw_query, document_id);
+}
+
+vector_of_matched SearchServer::MatchDocument(AdaptiveExecutionPolicy policy, const std::string_view raw_query, int document_id) const {
+    return MatchDocument(raw_query, document_id);
 }
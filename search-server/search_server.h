@@ -7,42 +7,208 @@
 #include <algorithm>
 #include <execution>
 #include <list>
+#include <deque>
+#include <unordered_map>
+#include <optional>
+#include <memory>
+#include <mutex>
+#include <array>
+#include <iterator>
+#include <cstdint>
+#include <atomic>
+#include <cmath>
+#include <numeric>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <limits>
 
 #include "document.h"
 #include "read_input_functions.h"
 #include "string_processing.h"
 #include "concurrent_map.h"
-
-const int MAX_RESULT_DOCUMENT_COUNT = 5;
+#include "word_frequencies.h"
+#include "posting_list.h"
+#include "document_filters.h"
+#include "roaring_bitmap.h"
+#include "positional_index.h"
+#include "ranking.h"
+#include "adaptive_execution.h"
+#include "counting_allocator.h"
+#include "memory_stats.h"
+#include "sorted_intersection.h"
+#include "stop_word_set.h"
+#include "cold_posting_store.h"
+#include "numa_execution.h"
+
+constexpr size_t MAX_RESULT_DOCUMENT_COUNT = 5;
 const double EPSILON = 1e-6;
 
 const size_t CONURRENT_MAP_TORRENTS = 10;
 
+const size_t MIN_MATCH_DOCUMENTS_PER_WORKER = 256;
+
+const size_t MIN_CACHED_BITMAP_POSTINGS = 1024;
+
+const size_t SCORE_BLOCK_SIZE = 64;
+
+const size_t PARALLEL_POSTING_RANGE_SIZE = 4096;
+
+const size_t MIN_REBUILD_POSTINGS_PER_WORKER = 1 << 16;
+
+const size_t MAX_PREFIX_EXPANSION = 64;
+
+const size_t MAX_CACHED_PREFIXES = 1024;
+
 using namespace std::literals;
 
 using vector_of_matched = std::tuple<std::vector<std::string_view>, DocumentStatus>;
 
+//Результат пакетного MatchDocuments: слова всех документов лежат подряд в words,
+//слова i-го документа - [offsets[i], offsets[i + 1]).
+struct MatchedDocuments {
+    std::vector<std::string_view> words;
+    std::vector<size_t> offsets;
+    std::vector<DocumentStatus> statuses;
+
+    size_t size() const {
+        return statuses.size();
+    }
+
+    auto WordsBegin(size_t index) const {
+        return words.begin() + offsets[index];
+    }
+
+    auto WordsEnd(size_t index) const {
+        return words.begin() + offsets[index + 1];
+    }
+};
+
+//Позиция в выдаче для постраничного поиска: следующая страница начинается
+//с документа, стоящего после этого.
+struct SearchCursor {
+    double relevance;
+    int rating;
+    int document_id;
+};
+
+//Что делать с документом, набор слов которого совпадает с уже добавленным.
+enum class DuplicatePolicy {
+    ALLOW,  //Добавить; найти такие документы можно через FindDuplicateDocuments.
+    REJECT, //AddDocument бросает std::invalid_argument.
+};
+
+struct SearchPage {
+    std::vector<Document> documents;
+    std::optional<SearchCursor> next; //Нет, если страница последняя.
+};
+
 class SearchServer {
 public:
+    //Итератор по id документов в порядке возрастания.
+    class DocumentIdIterator {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = int;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const int*;
+        using reference = const int&;
+
+        explicit DocumentIdIterator(std::map<int, size_t>::const_iterator it)
+            :it_(it)
+        {}
+
+        reference operator*() const {
+            return it_->first;
+        }
+
+        DocumentIdIterator& operator++() {
+            ++it_;
+            return *this;
+        }
+
+        DocumentIdIterator operator++(int) {
+            DocumentIdIterator old = *this;
+            ++it_;
+            return old;
+        }
+
+        DocumentIdIterator& operator--() {
+            --it_;
+            return *this;
+        }
+
+        DocumentIdIterator operator--(int) {
+            DocumentIdIterator old = *this;
+            --it_;
+            return old;
+        }
+
+        bool operator==(const DocumentIdIterator& other) const {
+            return it_ == other.it_;
+        }
+
+        bool operator!=(const DocumentIdIterator& other) const {
+            return it_ != other.it_;
+        }
+
+    private:
+        std::map<int, size_t>::const_iterator it_;
+    };
+
     template <typename StringCollection>
     explicit SearchServer(const StringCollection& stop_words);
 
+    //Сервер сразу со всеми документами: тексты разбираются по очереди, а обратный
+    //индекс строится один раз через Rebuild(policy). Элемент documents - запись
+    //с полями id, status, ratings и text, например CorpusRecord. Тексты копируются.
+    template <typename StringCollection, typename DocumentCollection, typename ExecutionPolicy>
+    SearchServer(ExecutionPolicy&& policy, const StringCollection& stop_words, const DocumentCollection& documents);
+
     explicit SearchServer(const std::string& text) :SearchServer(std::string_view(text))
     {}
 
     explicit SearchServer(const std::string_view text) :SearchServer(SplitIntoWords(text))
     {}
 
-    auto begin() const {
-        return index_.begin();
+    DocumentIdIterator begin() const {
+        return DocumentIdIterator(document_ordinals_.begin());
     }
 
-    auto end() const {
-        return index_.end();
+    DocumentIdIterator end() const {
+        return DocumentIdIterator(document_ordinals_.end());
     }
 
     void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
+    //Добавление без копирования слов: document лежит в буфере, который живёт,
+    //пока жив buffer_owner (например, shared_ptr на строку или отображённый файл).
+    //Новые слова словаря ссылаются прямо в буфер. Когда удалён последний документ
+    //буфера, его слова копируются в собственное хранилище и буфер освобождается.
+    void AddDocument(int document_id, const std::string_view document, std::shared_ptr<const void> buffer_owner, DocumentStatus status, const std::vector<int>& ratings);
+
+    //Включает позиционный индекс, нужный для фраз в запросах ("big dog").
+    //Вызывается до добавления документов.
+    void EnablePositionalIndex();
+
+    //Включает в запросах фразы ("big dog"), обязательные слова (+cat, +cat*) и
+    //группы ИЛИ (cat|dog). Без вызова запрос - список плюс- и минус-слов, а
+    //кавычки, + и | остаются частью слов, как раньше.
+    void EnableAdvancedQuerySyntax();
+
+    void SetDuplicatePolicy(DuplicatePolicy policy);
+
+    //Документ с меньшим id и тем же набором слов, если такой есть.
+    std::optional<int> FindDuplicateOf(int document_id) const;
+
+    //Дубликаты по возрастанию id: документы, у которых есть оригинал с меньшим id.
+    //Просматриваются только группы с одинаковым отпечатком набора слов.
+    std::vector<int> FindDuplicateDocuments() const;
+
+    void SetRankingModel(RankingModel model);
+
+    RankingModel GetRankingModel() const;
+
     std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status1 = DocumentStatus::ACTUAL) const;
 
     template <typename KeyMapper>
@@ -58,34 +224,173 @@ public:
 
     std::vector<Document> FindTopDocuments(std::execution::parallel_policy exec, const std::string_view raw_query, DocumentStatus status1 = DocumentStatus::ACTUAL) const;
 
+    //Выбирает seq или par по суммарному размеру списков документов слов запроса,
+    //см. GetExecutionThresholds.
+    template <typename KeyMapper>
+    std::vector<Document> FindTopDocuments(AdaptiveExecutionPolicy exec, const std::string_view raw_query, KeyMapper keymapper) const;
+
+    std::vector<Document> FindTopDocuments(AdaptiveExecutionPolicy exec, const std::string_view raw_query, DocumentStatus status1 = DocumentStatus::ACTUAL) const;
+
+    //Запрос делится на шарды по id документов между потоками пула политики,
+    //см. NumaExecutionPolicy. Запросы меньше порога GetExecutionThresholds
+    //и машины с одним процессором ищут последовательно.
+    template <typename KeyMapper>
+    std::vector<Document> FindTopDocuments(NumaExecutionPolicy exec, const std::string_view raw_query, KeyMapper keymapper) const;
+
+    std::vector<Document> FindTopDocuments(NumaExecutionPolicy exec, const std::string_view raw_query, DocumentStatus status1 = DocumentStatus::ACTUAL) const;
+
+    //Версии с числом результатов TopK вместо MAX_RESULT_DOCUMENT_COUNT.
+    //KeyMapper - предикат, фильтр из document_filters.h или DocumentStatus.
+    template <size_t TopK, typename KeyMapper>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, KeyMapper keymapper) const;
+
+    template <size_t TopK, typename ExecutionPolicy, typename KeyMapper>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy exec, const std::string_view raw_query, KeyMapper keymapper) const;
+
+    //Страница page (с нуля) выдачи по page_size документов. Сортируется только
+    //сама страница, документы предыдущих страниц лишь отделяются от неё.
+    template <typename KeyMapper>
+    std::vector<Document> FindDocumentsPage(const std::string_view raw_query, size_t page, size_t page_size, KeyMapper keymapper) const;
+
+    std::vector<Document> FindDocumentsPage(const std::string_view raw_query, size_t page, size_t page_size, DocumentStatus status = DocumentStatus::ACTUAL) const;
+
+    //page_size документов, идущих в выдаче после after (с начала, если after пуст).
+    //Порядок выдачи: релевантность, рейтинг, id - он полный, поэтому страницы
+    //не пересекаются и не теряют документы.
+    template <typename KeyMapper>
+    SearchPage FindDocumentsAfter(const std::string_view raw_query, const std::optional<SearchCursor>& after, size_t page_size, KeyMapper keymapper) const;
+
+    SearchPage FindDocumentsAfter(const std::string_view raw_query, const std::optional<SearchCursor>& after, size_t page_size, DocumentStatus status = DocumentStatus::ACTUAL) const;
+
     size_t GetDocumentCount() const;
 
+    //Растёт при каждом изменении, влияющем на результаты поиска.
+    //По нему кэши результатов узнают, что ответ устарел.
+    uint64_t GetGeneration() const;
+
+    //Оценка занятой памяти по частям индекса. Без top_terms работает за O(1)
+    //и годится для частого опроса; top_terms > 0 добавляет обход словаря.
+    MemoryStats GetMemoryStats(size_t top_terms = 0) const;
+
+    //Оставляет в памяти списки документов самых читаемых слов в пределах
+    //options.resident_bytes, остальные переносит в файл path. Холодный список
+    //читается с диска при запросе и кэшируется, см. ColdPostingStore. Изменение
+    //слова через AddDocument или RemoveDocument возвращает его список в память.
+    //Слова выбираются по числу чтений их списков с вызова EnableTermReadCounting,
+    //поэтому перед переносом стоит включить подсчёт и прогнать типичные запросы.
+    //Без подсчёта в памяти остаются самые короткие списки. Повторный вызов
+    //распределяет списки заново.
+    void MovePostingsToDisk(const std::string& path, const PostingTierOptions& options);
+
+    //Включает подсчёт чтений списков документов для MovePostingsToDisk.
+    //Подсчёт - атомарный инкремент общего счётчика на каждое слово запроса,
+    //поэтому по умолчанию он выключен. Не вызывается одновременно с поиском.
+    void EnableTermReadCounting(bool is_enabled = true);
+
+    //Пусто, если списки не переносились на диск.
+    std::optional<ColdPostingStats> GetColdPostingStats() const;
+
+    //Каноническая запись запроса: плюс- и минус-слова без стоп-слов и повторов,
+    //по алфавиту. Запросы с одинаковой записью дают одинаковый результат.
+    //Запросы с фразами, +словами и | возвращаются как есть.
+    std::string NormalizeQuery(const std::string_view raw_query) const;
+
+    //Слова запроса, найденные в документе. Для запроса с +словами, фразами
+    //и группами ИЛИ слов нет, если документ не выполняет какое-то из условий.
     vector_of_matched MatchDocument(const std::string_view raw_query, int document_id) const;
 
     vector_of_matched MatchDocument(std::execution::sequenced_policy policy, const std::string_view raw_query, int document_id) const;
 
     vector_of_matched MatchDocument(std::execution::parallel_policy policy, const std::string_view raw_query, int document_id) const;
 
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    vector_of_matched MatchDocument(AdaptiveExecutionPolicy policy, const std::string_view raw_query, int document_id) const;
+
+    MatchedDocuments MatchDocuments(const std::string_view raw_query, const std::vector<int>& document_ids) const;
+
+    MatchedDocuments MatchDocuments(std::execution::sequenced_policy policy, const std::string_view raw_query, const std::vector<int>& document_ids) const;
+
+    MatchedDocuments MatchDocuments(std::execution::parallel_policy policy, const std::string_view raw_query, const std::vector<int>& document_ids) const;
+
+    //Частоты слов документа по алфавиту без копирования. Представление
+    //действительно до следующего изменения сервера.
+    WordFrequencies GetWordFrequencies(int document_id) const;
+
+    const RoaringBitmap& GetDocumentsWithStatus(DocumentStatus status) const;
 
     void RemoveDocument(int document_id);
 
+    //Перестраивает обратный индекс по прямому, заодно вычищая из прямого
+    //удалённые документы. Списки документов получаются точного размера.
+    //Строится сортировкой подсчётом по id слова: куски документов считают
+    //свои записи, префиксные суммы дают каждому куску место в списках,
+    //затем куски пишут записи независимо. С par куски обрабатываются параллельно.
+    void Rebuild();
+
+    template <typename ExecutionPolicy>
+    void Rebuild(ExecutionPolicy&& policy);
+
+    //Rebuild с новым набором стоп-слов. Тексты документов не хранятся, поэтому
+    //документы не разбираются заново: слова, ставшие стоп-словами, вычёркиваются
+    //из прямого индекса, а длины документов и частоты слов пересчитываются.
+    //Вернуть прежнее стоп-слово так нельзя: набор без какого-то из текущих
+    //стоп-слов - std::invalid_argument, сервер при этом не меняется.
+    template <typename ExecutionPolicy, typename StringCollection>
+    void Rebuild(ExecutionPolicy&& policy, const StringCollection& stop_words);
+
     template<class ExecutionPolicy>
     void RemoveDocument(ExecutionPolicy&& policy, int document_id);
 
 
 private:
     //Структуры
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
-    };
-
     struct Query {
         std::vector<std::string_view> plus_words;
         std::vector<std::string_view> minus_words;
     };
 
+    struct QueryTerms {
+        std::vector<int> plus_terms;
+        std::vector<int> minus_terms;
+    };
+
+    //Ограничение раскрытия префиксных слов касается только ранжирования:
+    //минус-слово и MatchDocument должны видеть все слова под префиксом.
+    enum class PrefixExpansion {
+        BEST_TERMS, //Не больше MAX_PREFIX_EXPANSION слов с наибольшим вкладом.
+        ALL_TERMS,
+    };
+
+    //Запрос с фразами ("big dog"), обязательными словами (+cat) и
+    //группами ИЛИ (cat|dog). Все слова, кроме минус-слов, участвуют в ранжировании.
+    struct PhraseWord {
+        int term_id;
+        uint32_t offset; //Позиция слова относительно начала фразы.
+    };
+
+    struct AdvancedQuery {
+        std::vector<int> required_terms;
+        std::vector<std::vector<PhraseWord>> phrases;
+        std::vector<std::vector<int>> any_of_groups;
+        std::vector<int> scored_terms;
+        std::vector<int> minus_terms;
+        bool is_empty_result = false; //Какое-то условие не выполнимо ни для одного документа.
+
+        bool HasConstraints() const {
+            return is_empty_result || !required_terms.empty() || !phrases.empty() || !any_of_groups.empty();
+        }
+    };
+
+    struct DocumentRelevance {
+        double relevance = 0.0;
+        int rating = 0;
+    };
+
+    //Окно выдачи FindDocumentsAfter: не больше limit лучших документов, идущих после after.
+    struct RankWindow {
+        std::optional<Document> after;
+        size_t limit;
+    };
+
     struct QueryWord {
         std::string_view data;
         bool is_minus;
@@ -94,230 +399,991 @@ private:
 
     //Переменные.
 
-    std::set<std::string, std::less<>> stop_words_;
+    StopWordSet stop_words_;
+
+    //Память списков документов, объявлена раньше term_postings_ и переживает их.
+    std::unique_ptr<AllocationCounter> posting_allocations_ = std::make_unique<AllocationCounter>();
+
+    //id слова -> документы со словом, разбитые по статусам.
+    std::vector<PostingList> term_postings_;
+
+    //id слова -> сколько раз читался его список, пока включён подсчёт.
+    //В deque атомики не перемещаются при росте.
+    mutable std::deque<std::atomic<uint32_t>> term_reads_;
+    bool term_read_counting_enabled_ = false;
+
+    //Холодные списки, см. MovePostingsToDisk. nullptr - все списки в памяти.
+    std::unique_ptr<ColdPostingStore> cold_postings_;
+
+    //Таблица документов: id -> порядковый номер строки в столбцах ниже.
+    //При удалении последняя строка переносится на место удалённой.
+    std::map<int, size_t> document_ordinals_;
+    std::vector<int> document_ids_;
+    std::vector<int> document_ratings_;
+    std::vector<DocumentStatus> document_statuses_;
+    std::vector<uint32_t> document_lengths_; //Число не-стоп слов, для нормировки BM25.
+    std::vector<size_t> forward_offsets_;
+    std::vector<uint32_t> forward_sizes_;
+
+    //Прямой индекс: отсортированные id слов каждого документа подряд и их частоты,
+    //слова документа - [forward_offsets_[ordinal], + forward_sizes_[ordinal]).
+    std::vector<int> forward_terms_;
+    std::vector<double> forward_freqs_;
+    std::vector<uint32_t> forward_word_order_; //Позиции слов документа в forward_terms_ по алфавиту слов.
+    size_t forward_garbage_ = 0; //Сколько элементов forward_terms_ принадлежат удалённым документам.
+
+    std::array<RoaringBitmap, DOCUMENT_STATUS_COUNT> status_documents_;
+
+    RankingModel ranking_model_ = RankingModel::TF_IDF;
+    uint64_t generation_ = 0;
+    uint64_t total_document_length_ = 0;
+
+    //Позиционный индекс: для каждой записи forward_terms_ смещение её
+    //закодированных позиций в position_bytes_. Пуст, если индекс не включён.
+    bool positional_index_enabled_ = false;
+    bool advanced_query_syntax_enabled_ = false;
+    std::vector<size_t> forward_positions_;
+    std::vector<uint8_t> position_bytes_;
+
+    //Кэш битовых карт документов для частых слов, сбрасывается при изменении их списков.
+    mutable std::mutex term_bitmaps_mutex_;
+    mutable std::map<int, std::shared_ptr<const RoaringBitmap>> term_bitmaps_;
+
+    //Лучшие слова префиксов, под которыми больше MAX_PREFIX_EXPANSION слов.
+    //Оценки зависят от всего корпуса, поэтому кэш действителен, пока
+    //prefix_terms_generation_ совпадает с generation_.
+    mutable std::mutex prefix_terms_mutex_;
+    mutable uint64_t prefix_terms_generation_ = 0;
+    mutable std::map<std::string, std::vector<int>, std::less<>> prefix_terms_;
+
+    //Копия обратного индекса для numa_execution, поделённая между узлами пула:
+    //узел получает сплошной диапазон id документов, его списки строит поток
+    //этого узла, поэтому память выделяется на узле. Холодные списки не
+    //копируются и читаются из cold_postings_, как и без шардов.
+    struct NumaPostingShard {
+        size_t first_worker; //Потоки узла - [first_worker, first_worker следующего шарда).
+        std::vector<PostingList> term_postings;
+    };
+    struct NumaPostingShards {
+        uint64_t generation;
+        std::vector<int> worker_nodes; //Узел каждого потока пула, для которого построены шарды.
+        std::vector<bool> cold_terms;  //Слова, холодные на момент построения.
+        std::unique_ptr<AllocationCounter> allocations = std::make_unique<AllocationCounter>();
+        std::vector<NumaPostingShard> shards;
+    };
+    //Шарды последнего пула, действительны, пока generation совпадает с generation_.
+    mutable std::mutex numa_shards_mutex_;
+    mutable std::shared_ptr<const NumaPostingShards> numa_shards_;
+
+    //Словарь: слово -> id. Ключи указывают либо в owned_terms_, либо в буфер документа из shared_buffers_.
+    std::map<std::string_view, int, std::less<>> term_ids_;
+    std::vector<std::string_view> terms_; //id слова -> слово, тот же вид, что и ключ term_ids_.
+    std::deque<std::string> owned_terms_; //deque не перемещает строки при росте.
+    size_t owned_term_heap_bytes_ = 0; //Память owned_terms_ вне самих объектов std::string.
+
+    //Чужой буфер с текстами документов и слова словаря, ключи которых в нём лежат.
+    struct SharedBuffer {
+        std::shared_ptr<const void> owner;
+        size_t document_count = 0;
+        std::vector<int> anchored_terms;
+    };
+    std::unordered_map<const void*, SharedBuffer> shared_buffers_;
+    std::vector<const void*> document_buffers_; //Столбец таблицы документов, nullptr - текст скопирован.
 
-    //map<слово, map << документ id, freqs>> 
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
+    //Отпечаток набора слов документа -> документы с ним. Поддерживается
+    //в AddDocument и RemoveDocument, дубликат находится за O(слов документа).
+    std::vector<uint64_t> document_fingerprints_;
+    std::unordered_map<uint64_t, std::vector<int>> fingerprint_documents_;
+    DuplicatePolicy duplicate_policy_ = DuplicatePolicy::ALLOW;
 
-    //
-    std::map<int, std::map<std::string_view, double>> documents_word_freqs_;
+    //Функции
 
-    std::map<int, DocumentData> documents_;
-    std::set<int> index_;
+    bool IsStopWord(const std::string_view word) const;
 
-    std::set<std::string, std::less<>> string_set_; //Хранилище всех не-стоп слов.
+    std::vector<int> SplitIntoWordsNoStop(const std::string_view& text, std::vector<uint32_t>* positions = nullptr, SharedBuffer* buffer = nullptr);
 
-    //Функции
+    //Общая часть AddDocument. Без insert_postings обратный индекс не меняется,
+    //его потом строит Rebuild.
+    void StoreDocument(int document_id, const std::string_view document, std::shared_ptr<const void> buffer_owner, DocumentStatus status, const std::vector<int>& ratings, bool insert_postings);
 
-    bool IsStopWord(const std::string_view word) const;
+    //Список слова для чтения, у холодного слова - из cold_postings_.
+    //Результат нужно держать, пока читаются разделы списка.
+    std::shared_ptr<const PostingList> GetTermPostings(int term_id) const;
 
-    std::vector<std::string_view> SplitIntoWordsNoStop(const std::string_view& text);
+    //Список слова для изменения: холодный список сначала возвращается в память.
+    //Для разных слов можно вызывать из разных потоков.
+    PostingList& GetMutablePostings(int term_id);
+
+    void LoadColdPostings();
+
+    //Запись списка для i-го слова прямого индекса документа ordinal.
+    Posting MakePosting(size_t ordinal, size_t i) const;
+
+    //Шарды списков для узлов пула, строятся при первом запросе после изменения
+    //индекса. nullptr - все потоки пула на одном узле, делить индекс незачем.
+    std::shared_ptr<const NumaPostingShards> GetNumaPostingShards(PinnedWorkerPool& pool) const;
+
+    //Списки документов ordinals (по возрастанию id) без слов из skipped_terms.
+    std::vector<PostingList> BuildPostingShard(const std::vector<size_t>& ordinals, const std::vector<bool>& skipped_terms, AllocationCounter* counter) const;
+
+    //Новое слово ссылается в buffer, если он задан, иначе копируется в owned_terms_.
+    int GetOrAddTermId(const std::string_view word, SharedBuffer* buffer = nullptr);
+
+    std::string_view AddOwnedTerm(const std::string_view word);
+
+    //Переносит слова, лежащие в буфере, в owned_terms_ и отпускает буфер.
+    void RetireSharedBuffer(const void* buffer_key);
+
+    //sorted_terms - отсортированные id слов документа, возможно с повторами.
+    static uint64_t ComputeFingerprint(const std::vector<int>& sorted_terms);
+
+    bool HasSameTermsDocument(const std::vector<int>& group, const std::vector<int>& sorted_terms) const;
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
+    bool HasDocument(int document_id) const;
+
+    size_t GetDocumentOrdinal(int document_id) const;
+
+    const int* ForwardTermsBegin(size_t ordinal) const;
+
+    const int* ForwardTermsEnd(size_t ordinal) const;
+
+    void EraseDocumentData(int document_id);
+
+    //Переписывает прямой индекс без записей удалённых документов. Слова из
+    //dropped_terms вычёркиваются и из живых документов, длины и частоты таких
+    //документов пересчитываются.
+    void CompactForwardIndex(const std::vector<bool>* dropped_terms = nullptr);
+
+    //Алфавитный порядок слов документа для GetWordFrequencies.
+    void SortWordOrder(size_t ordinal);
+
+    template <typename StringCollection>
+    static StopWordSet MakeStopWordSet(const StringCollection& stop_words);
+
+    //Проверяет, что stop_words содержит все текущие стоп-слова, и вычёркивает
+    //новые стоп-слова из прямого индекса. Обратный индекс затем строит Rebuild.
+    void ReplaceStopWords(StopWordSet stop_words);
+
     QueryWord ParseQueryWord(std::string_view text) const;
 
-    Query ParseQuery(const std::string_view text, bool is_for_par = false) const;
+    Query ParseQuery(const std::string_view text) const;
 
     static bool IsValidWord(const std::string_view word);
 
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const;
+    //Слова вида dog* раскрываются в слова словаря с этим префиксом. Плюс-слова -
+    //по plus_expansion, минус-слова - всегда полностью.
+    QueryTerms ResolveQueryTerms(const Query& query, PrefixExpansion plus_expansion = PrefixExpansion::BEST_TERMS) const;
 
-    template <typename KeyMapper>
-    std::vector<Document> FindAllDocuments(const Query& query, KeyMapper keymapper) const;
+    static bool IsPrefixWord(const std::string_view word);
+
+    //Слова словаря с префиксом prefix, у которых есть документы. Для BEST_TERMS,
+    //если их больше MAX_PREFIX_EXPANSION, остаются слова с наибольшей оценкой
+    //сверху вклада: лучшие документы запроса дают именно они, а время поиска
+    //не растёт с числом слов под коротким префиксом. Выбор запоминается до
+    //изменения индекса, и повторный запрос с тем же префиксом не обходит словарь.
+    void ExpandPrefix(const std::string_view prefix, PrefixExpansion expansion_mode, std::vector<int>& terms) const;
+
+    bool IsAdvancedQuery(const std::string_view raw_query) const;
+
+    AdvancedQuery ParseAdvancedQuery(std::string_view text, PrefixExpansion plus_expansion = PrefixExpansion::BEST_TERMS) const;
+
+    void AddPhrase(const std::string_view text, AdvancedQuery& query) const;
+
+    std::optional<int> FindTermId(const std::string_view word) const;
+
+    std::vector<int> FindAdvancedCandidates(const AdvancedQuery& query, DocumentStatus partition) const;
+
+    bool ContainsPhrases(const AdvancedQuery& query, size_t ordinal) const;
+
+    template <typename Ranker>
+    double ComputeAdvancedRelevance(const AdvancedQuery& query, const std::vector<Ranker>& rankers, size_t ordinal) const;
+
+    template <typename Ranker, typename KeyMapper>
+    std::vector<Document> FindAdvancedDocuments(const AdvancedQuery& query, std::optional<DocumentStatus> status, KeyMapper keymapper, const RankWindow* window = nullptr) const;
+
+    //Обязательные слова, группы ИЛИ и фразы запроса есть в документе.
+    bool SatisfiesConstraints(const AdvancedQuery& query, size_t ordinal) const;
+
+    //Запрос для MatchDocument: обычный запрос - это AdvancedQuery без условий.
+    //Префиксные слова раскрываются полностью.
+    AdvancedQuery ParseMatchQuery(const std::string_view raw_query) const;
+
+    DocumentStatus AppendMatchedWords(const AdvancedQuery& query, int document_id, std::vector<std::string_view>& matched_words) const;
+
+    MatchedDocuments MatchDocumentsInChunks(const AdvancedQuery& query, const std::vector<int>& document_ids, size_t chunk_count) const;
+
+    CorpusStats GetCorpusStats() const;
+
+    //Вызывает callback с RankerTag выбранной модели ранжирования.
+    template <typename Callback>
+    auto DispatchRanker(Callback callback) const;
+
+    //Оценки документов считаются блоками в отдельном цикле без ветвлений,
+    //чтобы компилятор мог его векторизовать. В callback попадают только
+    //документы, прошедшие фильтр; фильтр с MatchBlock проверяет блок целиком.
+    template <typename Ranker, typename KeyMapper, typename Callback>
+    static void ForEachScoredPosting(const Posting* first, const Posting* last, const Ranker& ranker,
+        const KeyMapper& keymapper, DocumentStatus partition, Callback callback);
+
+    static double FindKthRelevance(const std::map<int, DocumentRelevance>& document_to_relevance, size_t k);
+
+    //k-я по убыванию релевантность, relevances.size() >= k. Порядок relevances меняется.
+    static double FindKthRelevance(std::vector<double>& relevances, size_t k);
+
+    std::shared_ptr<const RoaringBitmap> GetTermBitmap(int term_id) const;
+
+    //Документы, исключённые минус-словами, или nullptr, если исключать нечего.
+    std::shared_ptr<const RoaringBitmap> BuildExcludedDocuments(const QueryTerms& query_terms) const;
+
+    void InvalidateTermBitmaps(const int* terms_begin, const int* terms_end);
+
+    //Фильтр StatusIs превращается в выбор раздела списков, остальные фильтры
+    //проверяются в каждом разделе.
+    template <size_t TopK, typename ExecutionPolicy, typename KeyMapper>
+    std::vector<Document> FindTopDocumentsInPartitions(ExecutionPolicy policy, const std::string_view raw_query, KeyMapper keymapper) const;
+
+    //Все найденные документы без сортировки. top_k > 0 - нужны только лучшие top_k.
+    //С окном window (только для seq) - лишь документы окна в виде кучи AddToWindow.
+    template <typename ExecutionPolicy, typename KeyMapper>
+    std::vector<Document> FindMatchedDocuments(ExecutionPolicy policy, const std::string_view raw_query, KeyMapper keymapper, size_t top_k, const RankWindow* window = nullptr) const;
+
+    //Полный порядок выдачи: релевантность, рейтинг, при равенстве - id. Один
+    //и тот же во всех политиках выполнения и в постраничной выдаче.
+    static bool IsRankedBefore(const Document& lhs, const Document& rhs);
+
+    //Добавляет документ в окно, если он идёт после window.after. documents - куча
+    //по IsRankedBefore с худшим документом окна на вершине, размер не больше window.limit.
+    static void AddToWindow(const RankWindow& window, std::vector<Document>& documents, const Document& document);
+
+    template <size_t TopK, typename ExecutionPolicy>
+    static void SelectTopDocuments(ExecutionPolicy policy, std::vector<Document>& documents);
 
     template <typename KeyMapper>
-    std::vector<Document> FindAllDocuments(std::execution::sequenced_policy exec, const Query& query, KeyMapper keymapper) const;
+    static bool PassesFilter(const KeyMapper& keymapper, int document_id, DocumentStatus status, int rating);
 
     template <typename KeyMapper>
-    std::vector<Document> FindAllDocuments(std::execution::parallel_policy exec,  const Query& query, KeyMapper keymapper) const;
+    static bool PassesFilter(const KeyMapper& keymapper, const Posting& posting, DocumentStatus status);
+
+    //top_k > 0 разрешает отсечение: когда оценка сверху оставшихся слов меньше
+    //top_k-й релевантности, новые документы больше не заводятся.
+    template <typename Ranker, typename KeyMapper>
+    std::vector<Document> FindAllDocuments(std::execution::sequenced_policy exec, const QueryTerms& query_terms, std::optional<DocumentStatus> status, KeyMapper keymapper, size_t top_k, const RankWindow* window = nullptr) const;
+
+    //Списки документов режутся на куски по PARALLEL_POSTING_RANGE_SIZE, чтобы
+    //параллелился и запрос из одного частого слова. top_k > 0 разрешает то же
+    //отсечение, что и в seq: пока новые документы могут попасть в top_k, слова
+    //обходятся по одному в порядке оценки сверху, остальные - все вместе.
+    template <typename Ranker, typename KeyMapper>
+    std::vector<Document> FindAllDocuments(std::execution::parallel_policy exec, const QueryTerms& query_terms, std::optional<DocumentStatus> status, KeyMapper keymapper, size_t top_k) const;
+
+    template <typename Ranker, typename KeyMapper>
+    std::vector<Document> FindAllDocuments(AdaptiveExecutionPolicy exec, const QueryTerms& query_terms, std::optional<DocumentStatus> status, KeyMapper keymapper, size_t top_k) const;
+
+    //Границы шардов - id документов на равных долях самого длинного раздела
+    //запроса, поэтому шарды примерно равны по работе.
+    template <typename Ranker, typename KeyMapper>
+    std::vector<Document> FindAllDocuments(NumaExecutionPolicy exec, const QueryTerms& query_terms, std::optional<DocumentStatus> status, KeyMapper keymapper, size_t top_k) const;
+
+    size_t CountPostings(const QueryTerms& query_terms, std::optional<DocumentStatus> status) const;
+
+    template <typename Callback>
+    static void ForEachPartition(std::optional<DocumentStatus> status, Callback callback);
 };
 
 //======================= 
 
 template <typename StringCollection>
-SearchServer::SearchServer(const StringCollection& stop_words) {
+SearchServer::SearchServer(const StringCollection& stop_words)
+    :stop_words_(MakeStopWordSet(stop_words))
+{
+    WarmUpExecutionThresholds();
+}
+
+template <typename StringCollection>
+StopWordSet SearchServer::MakeStopWordSet(const StringCollection& stop_words) {
+    std::vector<std::string_view> words;
     for (const std::string_view word : stop_words) {
         if (!IsValidWord(word)) {
             throw std::invalid_argument("wrong word in StringCollection"s);
         }
-        if (!word.empty())
-        {
-            stop_words_.insert(std::string{ word.begin(), word.end()});
-        }
+        words.push_back(word);
     }
+    return StopWordSet(words);
 }
 
+template <typename StringCollection, typename DocumentCollection, typename ExecutionPolicy>
+SearchServer::SearchServer(ExecutionPolicy&& policy, const StringCollection& stop_words, const DocumentCollection& documents)
+    :SearchServer(stop_words)
+{
+    for (const auto& document : documents) {
+        StoreDocument(document.id, document.text, nullptr, document.status, document.ratings, false);
+    }
+    Rebuild(policy);
+}
 
-template <typename KeyMapper>
-std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, KeyMapper keymapper) const {
-    const Query query = ParseQuery(raw_query);
+template <typename ExecutionPolicy, typename StringCollection>
+void SearchServer::Rebuild(ExecutionPolicy&& policy, const StringCollection& stop_words) {
+    ReplaceStopWords(MakeStopWordSet(stop_words));
+    Rebuild(policy);
+}
 
-    auto matched_documents = FindAllDocuments(query, keymapper);
+template <typename ExecutionPolicy>
+void SearchServer::Rebuild(ExecutionPolicy&& policy) {
+    if (forward_garbage_ > 0) {
+        CompactForwardIndex();
+    }
+    //Все списки строятся заново в памяти, холодные копии больше не нужны.
+    cold_postings_.reset();
+
+    //Документы по возрастанию id: в этом порядке записи лягут в списки.
+    std::vector<size_t> ordinals;
+    ordinals.reserve(document_ordinals_.size());
+    for (const auto& [document_id, ordinal] : document_ordinals_) {
+        ordinals.push_back(ordinal);
+    }
+
+    //Корзина - раздел списка: пара (слово, статус). Таблицы счётчиков кусков
+    //не должны быть больше самих записей, поэтому кусков не больше postings / корзин.
+    const size_t bucket_count = term_postings_.size() * DOCUMENT_STATUS_COUNT;
+    size_t chunk_count = 1;
+    if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::parallel_policy>) {
+        const size_t worker_count = std::max(1u, std::thread::hardware_concurrency());
+        chunk_count = std::clamp<size_t>(forward_terms_.size() / std::max(bucket_count, MIN_REBUILD_POSTINGS_PER_WORKER), 1, worker_count);
+    }
+    const auto bucket_of = [](int term_id, DocumentStatus status) {
+        return static_cast<size_t>(term_id) * DOCUMENT_STATUS_COUNT + static_cast<size_t>(status);
+    };
+    std::vector<size_t> chunks(chunk_count);
+    std::iota(chunks.begin(), chunks.end(), 0);
+    const auto for_each_ordinal = [&](size_t chunk, auto callback) {
+        const size_t first = ordinals.size() * chunk / chunk_count;
+        const size_t last = ordinals.size() * (chunk + 1) / chunk_count;
+        for (size_t i = first; i < last; ++i) {
+            callback(ordinals[i]);
+        }
+    };
 
-    sort(matched_documents.begin(), matched_documents.end(),
-        [](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-                return lhs.rating > rhs.rating;
+    //1. Каждый кусок считает свои записи в каждой корзине.
+    std::vector<std::vector<uint32_t>> chunk_cursors(chunk_count);
+    std::for_each(policy, chunks.begin(), chunks.end(), [&](size_t chunk) {
+        std::vector<uint32_t>& counts = chunk_cursors[chunk];
+        counts.assign(bucket_count, 0);
+        for_each_ordinal(chunk, [&](size_t ordinal) {
+            for (const int* term_it = ForwardTermsBegin(ordinal); term_it != ForwardTermsEnd(ordinal); ++term_it) {
+                ++counts[bucket_of(*term_it, document_statuses_[ordinal])];
             }
-            else {
-                return lhs.relevance > rhs.relevance;
+        });
+    });
+
+    //2. Префиксные суммы по кускам внутри корзины: счётчик куска становится
+    //позицией его первой записи, сумма - размером раздела.
+    std::vector<Posting*> partitions(bucket_count);
+    std::vector<int> term_ids(term_postings_.size());
+    std::iota(term_ids.begin(), term_ids.end(), 0);
+    std::for_each(policy, term_ids.begin(), term_ids.end(), [&](int term_id) {
+        PostingList& postings = term_postings_[term_id];
+        postings = PostingList(posting_allocations_.get());
+        for (const DocumentStatus status : ALL_DOCUMENT_STATUSES) {
+            const size_t bucket = bucket_of(term_id, status);
+            uint32_t offset = 0;
+            for (std::vector<uint32_t>& cursors : chunk_cursors) {
+                offset += std::exchange(cursors[bucket], offset);
+            }
+            partitions[bucket] = postings.ResizePartition(status, offset);
+        }
+    });
+
+    //3. Куски пишут записи на свои места, не пересекаясь.
+    std::for_each(policy, chunks.begin(), chunks.end(), [&](size_t chunk) {
+        std::vector<uint32_t>& cursors = chunk_cursors[chunk];
+        for_each_ordinal(chunk, [&](size_t ordinal) {
+            const size_t offset = forward_offsets_[ordinal];
+            for (size_t i = offset; i < offset + forward_sizes_[ordinal]; ++i) {
+                const size_t bucket = bucket_of(forward_terms_[i], document_statuses_[ordinal]);
+                partitions[bucket][cursors[bucket]++] = MakePosting(ordinal, i);
             }
         });
+        cursors = {};
+    });
+
+    std::for_each(policy, term_postings_.begin(), term_postings_.end(), [](PostingList& postings) {
+        postings.Seal();
+    });
 
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    {
+        std::lock_guard<std::mutex> guard(term_bitmaps_mutex_);
+        term_bitmaps_.clear();
     }
-    return matched_documents;
+    ++generation_;
+}
+
+
+template <typename KeyMapper>
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, KeyMapper keymapper) const {
+    return FindTopDocuments(std::execution::seq, raw_query, keymapper);
 }
 
 template <typename KeyMapper>
 std::vector<Document> SearchServer::FindTopDocuments(std::execution::sequenced_policy exec, const std::string_view raw_query, KeyMapper keymapper) const {
-    return FindTopDocuments(raw_query, keymapper);
+    return FindTopDocumentsInPartitions<MAX_RESULT_DOCUMENT_COUNT>(exec, raw_query, MakeDocumentFilter(keymapper));
 }
 
 template <typename KeyMapper>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query, KeyMapper keymapper) const {
-    std::map<int, double> document_to_relevance;
+std::vector<Document> SearchServer::FindTopDocuments(std::execution::parallel_policy exec, const std::string_view raw_query, KeyMapper keymapper) const {
+    return FindTopDocumentsInPartitions<MAX_RESULT_DOCUMENT_COUNT>(exec, raw_query, MakeDocumentFilter(keymapper));
+}
 
-    for (const std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            if (keymapper(document_id, documents_.at(document_id).status, documents_.at(document_id).rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+template <typename KeyMapper>
+std::vector<Document> SearchServer::FindTopDocuments(AdaptiveExecutionPolicy exec, const std::string_view raw_query, KeyMapper keymapper) const {
+    return FindTopDocumentsInPartitions<MAX_RESULT_DOCUMENT_COUNT>(exec, raw_query, MakeDocumentFilter(keymapper));
+}
+
+template <typename KeyMapper>
+std::vector<Document> SearchServer::FindTopDocuments(NumaExecutionPolicy exec, const std::string_view raw_query, KeyMapper keymapper) const {
+    return FindTopDocumentsInPartitions<MAX_RESULT_DOCUMENT_COUNT>(exec, raw_query, MakeDocumentFilter(keymapper));
+}
+
+template <size_t TopK, typename KeyMapper>
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, KeyMapper keymapper) const {
+    return FindTopDocumentsInPartitions<TopK>(std::execution::seq, raw_query, MakeDocumentFilter(keymapper));
+}
+
+template <size_t TopK, typename ExecutionPolicy, typename KeyMapper>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy exec, const std::string_view raw_query, KeyMapper keymapper) const {
+    return FindTopDocumentsInPartitions<TopK>(exec, raw_query, MakeDocumentFilter(keymapper));
+}
+
+template <typename KeyMapper>
+std::vector<Document> SearchServer::FindDocumentsPage(const std::string_view raw_query, size_t page, size_t page_size, KeyMapper keymapper) const {
+    if (page_size == 0) {
+        throw std::invalid_argument("page_size can be zero"s);
+    }
+    const size_t first = page * page_size;
+    std::vector<Document> documents = FindMatchedDocuments(std::execution::seq, raw_query, MakeDocumentFilter(keymapper), first + page_size);
+    if (first >= documents.size()) {
+        return {};
+    }
+    const size_t last = std::min(first + page_size, documents.size());
+
+    std::nth_element(documents.begin(), documents.begin() + first, documents.end(), IsRankedBefore);
+    std::partial_sort(documents.begin() + first, documents.begin() + last, documents.end(), IsRankedBefore);
+    return { documents.begin() + first, documents.begin() + last };
+}
+
+template <typename KeyMapper>
+SearchPage SearchServer::FindDocumentsAfter(const std::string_view raw_query, const std::optional<SearchCursor>& after, size_t page_size, KeyMapper keymapper) const {
+    if (page_size == 0) {
+        throw std::invalid_argument("page_size can be zero"s);
+    }
+    //Лишний документ в окне показывает, что за страницей есть продолжение.
+    RankWindow window{ std::nullopt, page_size + 1 };
+    if (after) {
+        window.after = Document(after->document_id, after->relevance, after->rating);
+    }
+    std::vector<Document> documents = FindMatchedDocuments(std::execution::seq, raw_query, MakeDocumentFilter(keymapper), 0, &window);
+    std::sort_heap(documents.begin(), documents.end(), IsRankedBefore);
+
+    SearchPage result;
+    const bool has_more = documents.size() > page_size;
+    documents.resize(std::min(documents.size(), page_size));
+    result.documents = std::move(documents);
+    if (has_more) {
+        const Document& last = result.documents.back();
+        result.next = SearchCursor{ last.relevance, last.rating, last.id };
+    }
+    return result;
+}
+
+template <typename ExecutionPolicy, typename KeyMapper>
+std::vector<Document> SearchServer::FindMatchedDocuments(ExecutionPolicy policy, const std::string_view raw_query, KeyMapper keymapper, size_t top_k, const RankWindow* window) const {
+    //Запросы без фраз, + и | идут прежним путём и не платят за новый синтаксис.
+    auto find_all = [this, policy, raw_query, top_k, window](std::optional<DocumentStatus> status, auto filter) {
+        return DispatchRanker([&](auto ranker_tag) {
+            using Ranker = typename decltype(ranker_tag)::type;
+            const auto find_terms = [&](const QueryTerms& query_terms) {
+                if constexpr (std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
+                    return FindAllDocuments<Ranker>(policy, query_terms, status, filter, top_k, window);
+                }
+                else {
+                    return FindAllDocuments<Ranker>(policy, query_terms, status, filter, top_k);
+                }
+            };
+            if (IsAdvancedQuery(raw_query)) {
+                const AdvancedQuery query = ParseAdvancedQuery(raw_query);
+                if (query.HasConstraints()) {
+                    return FindAdvancedDocuments<Ranker>(query, status, filter, window);
+                }
+                return find_terms(QueryTerms{ query.scored_terms, query.minus_terms });
             }
-        }
+            return find_terms(ResolveQueryTerms(ParseQuery(raw_query)));
+        });
+    };
+
+    if constexpr (DocumentFilterTraits<KeyMapper>::selects_status) {
+        return find_all(keymapper.status, AnyDocument{});
+    }
+    else {
+        return find_all(std::nullopt, keymapper);
     }
+}
 
-    for (const std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+template <size_t TopK, typename ExecutionPolicy, typename KeyMapper>
+std::vector<Document> SearchServer::FindTopDocumentsInPartitions(ExecutionPolicy policy, const std::string_view raw_query, KeyMapper keymapper) const {
+    std::vector<Document> matched_documents = FindMatchedDocuments(policy, raw_query, keymapper, TopK);
+
+    if constexpr (std::is_same_v<ExecutionPolicy, AdaptiveExecutionPolicy> || std::is_same_v<ExecutionPolicy, NumaExecutionPolicy>) {
+        if (matched_documents.size() >= GetExecutionThresholds().min_parallel_postings) {
+            SelectTopDocuments<TopK>(std::execution::par, matched_documents);
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+        else {
+            SelectTopDocuments<TopK>(std::execution::seq, matched_documents);
         }
     }
-
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back(
-            { document_id, relevance, documents_.at(document_id).rating });
+    else {
+        SelectTopDocuments<TopK>(policy, matched_documents);
     }
     return matched_documents;
 }
 
-template<class ExecutionPolicy>
-void SearchServer::RemoveDocument(ExecutionPolicy&& policy, int document_id) {
-    if (documents_word_freqs_.count(document_id)) {
-        documents_.erase(document_id);
-        index_.erase(std::find(policy, index_.begin(), index_.end(), document_id));
+template <size_t TopK, typename ExecutionPolicy>
+void SearchServer::SelectTopDocuments(ExecutionPolicy policy, std::vector<Document>& documents) {
+    if (documents.size() > TopK) {
+        std::partial_sort(policy, documents.begin(), documents.begin() + TopK, documents.end(), IsRankedBefore);
+        documents.resize(TopK);
+    }
+    else {
+        std::sort(policy, documents.begin(), documents.end(), IsRankedBefore);
+    }
+}
 
-        std::vector<std::string*> word_remove(documents_word_freqs_[document_id].size());
-        //word_remove.reserve(documents_word_freqs_[document_id].size());
+template <typename KeyMapper>
+bool SearchServer::PassesFilter(const KeyMapper& keymapper, int document_id, DocumentStatus status, int rating) {
+    if constexpr (DocumentFilterTraits<KeyMapper>::is_always_true) {
+        return true;
+    }
+    else {
+        return keymapper(document_id, status, rating);
+    }
+}
 
-        std::transform(policy,
-            documents_word_freqs_[document_id].begin(), documents_word_freqs_[document_id].end(),
-            word_remove.begin(),
-            [](auto& word_freq) {
-                return const_cast<std::string*>(&word_freq.first); });
+template <typename KeyMapper>
+bool SearchServer::PassesFilter(const KeyMapper& keymapper, const Posting& posting, DocumentStatus status) {
+    return PassesFilter(keymapper, posting.document_id, status, posting.rating);
+}
 
+template <typename Ranker, typename KeyMapper>
+std::vector<Document> SearchServer::FindAdvancedDocuments(const AdvancedQuery& query, std::optional<DocumentStatus> status, KeyMapper keymapper, const RankWindow* window) const {
+    std::vector<Document> matched_documents;
+    if (query.is_empty_result) {
+        return matched_documents;
+    }
+    const std::shared_ptr<const RoaringBitmap> excluded = BuildExcludedDocuments(QueryTerms{ {}, query.minus_terms });
 
+    const CorpusStats corpus = GetCorpusStats();
+    std::vector<Ranker> rankers;
+    rankers.reserve(query.scored_terms.size());
+    for (const int term_id : query.scored_terms) {
+        rankers.emplace_back(corpus, std::max<size_t>(term_postings_[term_id].size(), 1));
+    }
 
-        std::for_each(policy,
-            word_remove.begin(), word_remove.end(),
-            [&](std::string* word) {
-                word_to_document_freqs_[*word].erase(document_id);
-        //if (!word_to_document_freqs_[*word].size()) {
-        //    word_to_document_freqs_.erase(*word);
-        //}
-            });
+    ForEachPartition(status, [&](DocumentStatus partition) {
+        for (const int document_id : FindAdvancedCandidates(query, partition)) {
+            if (excluded && excluded->Contains(document_id)) {
+                continue;
+            }
+            const size_t ordinal = GetDocumentOrdinal(document_id);
+            if (!PassesFilter(keymapper, document_id, partition, document_ratings_[ordinal])) {
+                continue;
+            }
+            if (!ContainsPhrases(query, ordinal)) {
+                continue;
+            }
+            const Document document(document_id, ComputeAdvancedRelevance(query, rankers, ordinal), document_ratings_[ordinal]);
+            if (window) {
+                AddToWindow(*window, matched_documents, document);
+            }
+            else {
+                matched_documents.push_back(document);
+            }
+        }
+    });
+    return matched_documents;
+}
 
-        /*
-        for (const auto& [word, freq] : documents_word_freqs_[document_id]) {
-            word_to_document_freqs_[word].erase(document_id);
+template <typename Ranker>
+double SearchServer::ComputeAdvancedRelevance(const AdvancedQuery& query, const std::vector<Ranker>& rankers, size_t ordinal) const {
+    const double document_length = document_lengths_[ordinal];
+    double relevance = 0.0;
+    ForEachIntersection(query.scored_terms.begin(), query.scored_terms.end(),
+        ForwardTermsBegin(ordinal), ForwardTermsEnd(ordinal),
+        [&](auto query_it, const int* term_it) {
+            const double term_count = forward_freqs_[term_it - forward_terms_.data()] * document_length;
+            relevance += rankers[query_it - query.scored_terms.begin()](term_count, document_length);
+        });
+    return relevance;
+}
+
+template <typename Callback>
+auto SearchServer::DispatchRanker(Callback callback) const {
+    switch (ranking_model_) {
+    case RankingModel::BM25:
+        return callback(RankerTag<Bm25Ranker>{});
+    default:
+        return callback(RankerTag<TfIdfRanker>{});
+    }
+}
 
-            if (!word_to_document_freqs_[word].size()) {
-                word_to_document_freqs_.erase(word);
+template <typename Ranker, typename KeyMapper, typename Callback>
+void SearchServer::ForEachScoredPosting(const Posting* first, const Posting* last, const Ranker& ranker,
+    const KeyMapper& keymapper, DocumentStatus partition, Callback callback) {
+    double scores[SCORE_BLOCK_SIZE];
+    [[maybe_unused]] uint8_t passes[SCORE_BLOCK_SIZE];
+    const size_t size = last - first;
+    for (size_t block_begin = 0; block_begin < size; block_begin += SCORE_BLOCK_SIZE) {
+        const size_t block_size = std::min(SCORE_BLOCK_SIZE, size - block_begin);
+        const Posting* block = first + block_begin;
+        for (size_t i = 0; i < block_size; ++i) {
+            scores[i] = ranker(block[i].term_count, block[i].document_length);
+        }
+        if constexpr (DocumentFilterTraits<KeyMapper>::is_always_true) {
+            for (size_t i = 0; i < block_size; ++i) {
+                callback(block[i], scores[i]);
+            }
+        }
+        else if constexpr (DocumentFilterTraits<KeyMapper>::has_block_kernel) {
+            keymapper.MatchBlock(block, block_size, passes);
+            for (size_t i = 0; i < block_size; ++i) {
+                if (passes[i]) {
+                    callback(block[i], scores[i]);
+                }
+            }
+        }
+        else {
+            for (size_t i = 0; i < block_size; ++i) {
+                if (PassesFilter(keymapper, block[i], partition)) {
+                    callback(block[i], scores[i]);
+                }
             }
         }
-        */
-        documents_word_freqs_.erase(document_id);
     }
 }
 
-template <typename KeyMapper>
-std::vector<Document> SearchServer::FindTopDocuments(std::execution::parallel_policy exec, const std::string_view raw_query, KeyMapper keymapper) const {
-    Query query = ParseQuery(raw_query, true);
+template <typename Callback>
+void SearchServer::ForEachPartition(std::optional<DocumentStatus> status, Callback callback) {
+    if (status) {
+        callback(*status);
+        return;
+    }
+    for (const DocumentStatus partition : ALL_DOCUMENT_STATUSES) {
+        callback(partition);
+    }
+}
 
-    std::sort(std::execution::par, query.plus_words.begin(), query.plus_words.end());
-    query.plus_words.erase(std::unique(std::execution::par, query.plus_words.begin(), query.plus_words.end()), query.plus_words.end());
+template <typename Ranker, typename KeyMapper>
+std::vector<Document> SearchServer::FindAllDocuments(std::execution::sequenced_policy exec, const QueryTerms& query_terms, std::optional<DocumentStatus> status, KeyMapper keymapper, size_t top_k, const RankWindow* window) const {
+    const std::shared_ptr<const RoaringBitmap> excluded = BuildExcludedDocuments(query_terms);
+    const CorpusStats corpus = GetCorpusStats();
 
-    //std::sort(query.minus_words.begin(), query.minus_words.begin());
-    //query.minus_words.erase(std::unique(query.minus_words.begin(), query.minus_words.end()), query.minus_words.end());
+    struct TermScan {
+        std::shared_ptr<const PostingList> postings;
+        Ranker ranker;
+        double upper_bound;
+    };
+    std::vector<TermScan> scans;
+    for (const int term_id : query_terms.plus_terms) {
+        const PostingList& postings = term_postings_[term_id];
+        if (postings.empty()) {
+            continue;
+        }
+        const Ranker ranker(corpus, postings.size());
+        scans.push_back({ GetTermPostings(term_id), ranker, ranker(postings.GetMaxTermCount(), postings.GetMinDocumentLength()) });
+    }
 
-    auto matched_documents = FindAllDocuments(std::execution::par, query, keymapper);
+    //Слова с большим вкладом первыми: тогда хвост запроса чаще не способен ввести в топ новые документы.
+    std::sort(scans.begin(), scans.end(), [](const TermScan& lhs, const TermScan& rhs) {
+        return lhs.upper_bound > rhs.upper_bound;
+    });
+    std::vector<double> remaining_upper_bound(scans.size() + 1, 0.0);
+    for (size_t i = scans.size(); i > 0; --i) {
+        remaining_upper_bound[i - 1] = remaining_upper_bound[i] + scans[i - 1].upper_bound;
+    }
 
-    sort(std::execution::par,  matched_documents.begin(), matched_documents.end(),
-        [](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-                return lhs.rating > rhs.rating;
-            }
-            else {
-                return lhs.relevance > rhs.relevance;
-            }
+    std::map<int, DocumentRelevance> document_to_relevance;
+    bool accepts_new_documents = true;
+
+    for (size_t i = 0; i < scans.size(); ++i) {
+        if (accepts_new_documents && top_k > 0 && document_to_relevance.size() >= top_k) {
+            accepts_new_documents = remaining_upper_bound[i] + EPSILON >= FindKthRelevance(document_to_relevance, top_k);
+        }
+        ForEachPartition(status, [&](DocumentStatus partition) {
+            const PostingVector& postings = scans[i].postings->GetPostings(partition);
+            ForEachScoredPosting(postings.data(), postings.data() + postings.size(), scans[i].ranker, keymapper, partition, [&](const Posting& posting, double score) {
+                if (excluded && excluded->Contains(posting.document_id)) {
+                    return;
+                }
+                if (accepts_new_documents) {
+                    DocumentRelevance& document = document_to_relevance[posting.document_id];
+                    document.relevance += score;
+                    document.rating = posting.rating;
+                }
+                else if (const auto it = document_to_relevance.find(posting.document_id); it != document_to_relevance.end()) {
+                    it->second.relevance += score;
+                }
+            });
         });
+    }
 
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    std::vector<Document> matched_documents;
+    for (const auto& [document_id, document] : document_to_relevance) {
+        if (window) {
+            AddToWindow(*window, matched_documents, { document_id, document.relevance, document.rating });
+        }
+        else {
+            matched_documents.push_back(
+                { document_id, document.relevance, document.rating });
+        }
     }
     return matched_documents;
 }
 
-template <typename KeyMapper>
-std::vector<Document> SearchServer::FindAllDocuments(std::execution::sequenced_policy exec, const Query& query, KeyMapper keymapper) const {
-    return FindAllDocuments(query, keymapper);
+template <typename Ranker, typename KeyMapper>
+std::vector<Document> SearchServer::FindAllDocuments(AdaptiveExecutionPolicy exec, const QueryTerms& query_terms, std::optional<DocumentStatus> status, KeyMapper keymapper, size_t top_k) const {
+    if (CountPostings(query_terms, status) >= GetExecutionThresholds().min_parallel_postings) {
+        return FindAllDocuments<Ranker>(std::execution::par, query_terms, status, keymapper, top_k);
+    }
+    return FindAllDocuments<Ranker>(std::execution::seq, query_terms, status, keymapper, top_k);
 }
 
-template <typename KeyMapper>
-std::vector<Document> SearchServer::FindAllDocuments(std::execution::parallel_policy exec, const Query& query, KeyMapper keymapper) const {
-    //std::map<int, double> document_to_relevance;
-    ConcurrentMap<int, double> document_to_relevance(CONURRENT_MAP_TORRENTS);
-
-    std::for_each(std::execution::par,
-        query.plus_words.begin(), query.plus_words.end(),
-        [this, &keymapper, &document_to_relevance](std::string_view word) {
-            if (word_to_document_freqs_.count(word) != 0) {
-                const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                for (const auto& [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                    if (keymapper(document_id, documents_.at(document_id).status, documents_.at(document_id).rating)) {
-                        document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-                    }
+template <typename Ranker, typename KeyMapper>
+std::vector<Document> SearchServer::FindAllDocuments(NumaExecutionPolicy exec, const QueryTerms& query_terms, std::optional<DocumentStatus> status, KeyMapper keymapper, size_t top_k) const {
+    PinnedWorkerPool& pool = GetPinnedWorkerPool(exec);
+    if (pool.GetWorkerCount() <= 1 || CountPostings(query_terms, status) < GetExecutionThresholds().min_parallel_postings) {
+        return FindAllDocuments<Ranker>(std::execution::seq, query_terms, status, keymapper, top_k);
+    }
+
+    const std::shared_ptr<const RoaringBitmap> excluded = BuildExcludedDocuments(query_terms);
+    const CorpusStats corpus = GetCorpusStats();
+    const std::shared_ptr<const NumaPostingShards> numa_shards = GetNumaPostingShards(pool);
+    const size_t worker_count = pool.GetWorkerCount();
+    const size_t node_count = numa_shards ? numa_shards->shards.size() : 1;
+
+    //Списки слов запроса на каждом узле: из шарда узла или, для холодного
+    //слова и без шардов, общий список.
+    std::vector<Ranker> rankers;
+    std::vector<std::shared_ptr<const PostingList>> term_lists;
+    std::vector<std::vector<const PostingList*>> node_lists(node_count);
+    for (const int term_id : query_terms.plus_terms) {
+        if (term_postings_[term_id].empty()) {
+            continue;
+        }
+        const PostingList& postings = *term_lists.emplace_back(GetTermPostings(term_id));
+        rankers.emplace_back(corpus, postings.size());
+        for (size_t node = 0; node < node_count; ++node) {
+            const bool is_shared = !numa_shards || numa_shards->cold_terms[term_id];
+            node_lists[node].push_back(is_shared ? &postings : &numa_shards->shards[node].term_postings[term_id]);
+        }
+    }
+    if (rankers.empty()) {
+        return {};
+    }
+
+    //Потоки узла делят его диапазон по самому длинному списку узла.
+    //Первый поток узла начинает с его начала, последний доходит до конца.
+    std::vector<size_t> worker_node(worker_count, 0);
+    std::vector<bool> is_last_on_node(worker_count, false);
+    std::vector<int> shard_bounds(worker_count, std::numeric_limits<int>::min());
+    for (size_t node = 0; node < node_count; ++node) {
+        const size_t first_worker = numa_shards ? numa_shards->shards[node].first_worker : 0;
+        const size_t last_worker = numa_shards && node + 1 < node_count ? numa_shards->shards[node + 1].first_worker : worker_count;
+        const PostingVector* longest = nullptr;
+        for (const PostingList* postings : node_lists[node]) {
+            ForEachPartition(status, [&](DocumentStatus partition) {
+                const PostingVector& partition_postings = postings->GetPostings(partition);
+                if (longest == nullptr || partition_postings.size() > longest->size()) {
+                    longest = &partition_postings;
                 }
+            });
+        }
+        const size_t node_workers = last_worker - first_worker;
+        for (size_t worker = first_worker; worker < last_worker; ++worker) {
+            worker_node[worker] = node;
+            const size_t index = worker - first_worker;
+            if (index > 0) {
+                shard_bounds[worker] = longest->empty() ? std::numeric_limits<int>::max() : (*longest)[longest->size() * index / node_workers].document_id;
             }
         }
-    );
+        is_last_on_node[last_worker - 1] = true;
+    }
 
+    //Накопитель заводит сам поток, поэтому его память выделяется на узле потока.
+    //Результаты соседних потоков разнесены по разным кэш-линиям.
+    struct alignas(CACHE_LINE_SIZE) ShardResult {
+        std::vector<Document> documents;
+    };
+    std::vector<ShardResult> shard_results(worker_count);
+    const auto posting_less = [](const Posting& posting, int document_id) {
+        return posting.document_id < document_id;
+    };
 
-    std::for_each(std::execution::par,
-        query.minus_words.begin(), query.minus_words.end(),
-        [this, &document_to_relevance](std::string_view word) {
-            if (word_to_document_freqs_.count(word) != 0) {
-                for (const auto& [document_id, _] : word_to_document_freqs_.at(word)) {
-                    document_to_relevance.erase(document_id);
-                }
+    pool.Run([&](size_t worker) {
+        const int first_id = shard_bounds[worker];
+        const bool is_last = is_last_on_node[worker];
+        if (!is_last && first_id >= shard_bounds[worker + 1]) {
+            return;
+        }
+        const std::vector<const PostingList*>& lists = node_lists[worker_node[worker]];
+        std::map<int, DocumentRelevance> document_to_relevance;
+        for (size_t term = 0; term < lists.size(); ++term) {
+            ForEachPartition(status, [&](DocumentStatus partition) {
+                const PostingVector& postings = lists[term]->GetPostings(partition);
+                const Posting* const end = postings.data() + postings.size();
+                const Posting* first = std::lower_bound(postings.data(), end, first_id, posting_less);
+                const Posting* last = is_last ? end : std::lower_bound(first, end, shard_bounds[worker + 1], posting_less);
+                ForEachScoredPosting(first, last, rankers[term], keymapper, partition, [&](const Posting& posting, double score) {
+                    if (excluded && excluded->Contains(posting.document_id)) {
+                        return;
+                    }
+                    DocumentRelevance& document = document_to_relevance[posting.document_id];
+                    document.relevance += score;
+                    document.rating = posting.rating;
+                });
+            });
+        }
+        std::vector<Document>& documents = shard_results[worker].documents;
+        documents.reserve(document_to_relevance.size());
+        for (const auto& [document_id, document] : document_to_relevance) {
+            documents.push_back({ document_id, document.relevance, document.rating });
+        }
+        //Диапазоны потоков не пересекаются: лучшие top_k всего запроса
+        //есть среди лучших top_k каждого потока.
+        if (top_k > 0 && documents.size() > top_k) {
+            std::nth_element(documents.begin(), documents.begin() + (top_k - 1), documents.end(), IsRankedBefore);
+            documents.resize(top_k);
+        }
+    });
+
+    //Шарды не пересекаются по id, поэтому результаты просто склеиваются.
+    std::vector<Document> matched_documents;
+    for (ShardResult& shard : shard_results) {
+        matched_documents.insert(matched_documents.end(), shard.documents.begin(), shard.documents.end());
+    }
+    return matched_documents;
+}
+
+template<class ExecutionPolicy>
+void SearchServer::RemoveDocument(ExecutionPolicy&& policy, int document_id) {
+    if (!HasDocument(document_id)) {
+        return;
+    }
+    const size_t ordinal = GetDocumentOrdinal(document_id);
+    const DocumentStatus status = document_statuses_[ordinal];
+
+    //Каждое слово документа встречается один раз, поэтому потоки меняют разные списки.
+    std::for_each(policy,
+        ForwardTermsBegin(ordinal), ForwardTermsEnd(ordinal),
+        [this, document_id, status](int term_id) {
+            GetMutablePostings(term_id).Erase(status, document_id);
+        });
+
+    EraseDocumentData(document_id);
+}
+
+template <typename Ranker, typename KeyMapper>
+std::vector<Document> SearchServer::FindAllDocuments(std::execution::parallel_policy exec, const QueryTerms& query_terms, std::optional<DocumentStatus> status, KeyMapper keymapper, size_t top_k) const {
+    const std::shared_ptr<const RoaringBitmap> excluded = BuildExcludedDocuments(query_terms);
+    const CorpusStats corpus = GetCorpusStats();
+    ConcurrentMap<int, DocumentRelevance> document_to_relevance(CONURRENT_MAP_TORRENTS);
+
+    struct PostingRange {
+        const Posting* first;
+        const Posting* last;
+        DocumentStatus partition;
+        size_t scan;
+    };
+    struct TermScan {
+        std::shared_ptr<const PostingList> postings;
+        Ranker ranker;
+        double upper_bound;
+    };
+    std::vector<TermScan> scans;
+    for (const int term_id : query_terms.plus_terms) {
+        const PostingList& postings = term_postings_[term_id];
+        if (postings.empty()) {
+            continue;
+        }
+        const Ranker ranker(corpus, postings.size());
+        scans.push_back({ GetTermPostings(term_id), ranker, ranker(postings.GetMaxTermCount(), postings.GetMinDocumentLength()) });
+    }
+    std::sort(scans.begin(), scans.end(), [](const TermScan& lhs, const TermScan& rhs) {
+        return lhs.upper_bound > rhs.upper_bound;
+    });
+    std::vector<double> remaining_upper_bound(scans.size() + 1, 0.0);
+    for (size_t i = scans.size(); i > 0; --i) {
+        remaining_upper_bound[i - 1] = remaining_upper_bound[i] + scans[i - 1].upper_bound;
+    }
+
+    //Куски слов идут подряд в порядке scans, term_ranges[i] - начало кусков слова i.
+    std::vector<PostingRange> ranges;
+    std::vector<size_t> term_ranges;
+    for (size_t i = 0; i < scans.size(); ++i) {
+        term_ranges.push_back(ranges.size());
+        ForEachPartition(status, [&](DocumentStatus partition) {
+            const PostingVector& partition_postings = scans[i].postings->GetPostings(partition);
+            for (size_t begin = 0; begin < partition_postings.size(); begin += PARALLEL_POSTING_RANGE_SIZE) {
+                const size_t end = std::min(begin + PARALLEL_POSTING_RANGE_SIZE, partition_postings.size());
+                ranges.push_back({ partition_postings.data() + begin, partition_postings.data() + end, partition, i });
+            }
+        });
+    }
+    term_ranges.push_back(ranges.size());
+
+    bool accepts_new_documents = true;
+    const auto score_ranges = [&](size_t first_range, size_t last_range) {
+        std::for_each(exec,
+            ranges.begin() + first_range, ranges.begin() + last_range,
+            [&](const PostingRange& range) {
+                ForEachScoredPosting(range.first, range.last, scans[range.scan].ranker, keymapper, range.partition, [&](const Posting& posting, double score) {
+                    if (excluded && excluded->Contains(posting.document_id)) {
+                        return;
+                    }
+                    if (accepts_new_documents) {
+                        auto access = document_to_relevance[posting.document_id];
+                        access.ref_to_value.relevance += score;
+                        access.ref_to_value.rating = posting.rating;
+                    }
+                    else {
+                        document_to_relevance.UpdateIfPresent(posting.document_id, [score](DocumentRelevance& document) {
+                            document.relevance += score;
+                        });
+                    }
+                });
             }
+        );
+    };
+
+    //Пока новые документы могут попасть в top_k, слова обходятся по одному.
+    size_t term = 0;
+    std::vector<double> relevances;
+    for (; top_k > 0 && term < scans.size(); ++term) {
+        relevances.clear();
+        document_to_relevance.ForEach([&relevances](int, const DocumentRelevance& document) {
+            relevances.push_back(document.relevance);
+        });
+        if (relevances.size() >= top_k && remaining_upper_bound[term] + EPSILON < FindKthRelevance(relevances, top_k)) {
+            accepts_new_documents = false;
+            break;
         }
-    );
+        score_ranges(term_ranges[term], term_ranges[term + 1]);
+    }
+    score_ranges(term_ranges[term], ranges.size());
 
     std::vector<Document> matched_documents;
-    for (const auto& [document_id, relevance] : document_to_relevance.BuildOrdinaryMap()) {
+    for (const auto& [document_id, document] : document_to_relevance.BuildOrdinaryMap()) {
         matched_documents.push_back(
-            { document_id, relevance, documents_.at(document_id).rating });
+            { document_id, document.relevance, document.rating });
     }
 
     return matched_documents;
 }
-
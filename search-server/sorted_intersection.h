@@ -0,0 +1,56 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+// Галопирующий lower_bound: шаг растёт вдвое, пока элементы меньше value,
+// затем бинарный поиск внутри последнего шага. Выгоден, когда искомые
+// значения идут по возрастанию и лежат недалеко от first.
+template <typename Iterator, typename Value, typename Less>
+Iterator GallopingLowerBound(Iterator first, Iterator last, const Value& value, Less less) {
+    using Difference = typename std::iterator_traits<Iterator>::difference_type;
+
+    const Difference size = std::distance(first, last);
+    if (size == 0 || !less(*first, value)) {
+        return first;
+    }
+
+    Difference low = 0;
+    Difference high = 1;
+    while (high < size && less(first[high], value)) {
+        low = high;
+        high *= 2;
+    }
+    return std::lower_bound(first + low + 1, first + std::min(high, size), value, less);
+}
+
+template <typename Iterator, typename Value>
+Iterator GallopingLowerBound(Iterator first, Iterator last, const Value& value) {
+    return GallopingLowerBound(first, last, value, std::less<>{});
+}
+
+template <typename Iterator, typename Value>
+bool GallopingContains(Iterator first, Iterator last, const Value& value) {
+    const Iterator it = GallopingLowerBound(first, last, value);
+    return it != last && !(value < *it);
+}
+
+// Пересечение двух отсортированных диапазонов без повторов.
+// callback получает итераторы на совпавшие элементы обоих диапазонов.
+template <typename Iterator1, typename Iterator2, typename Callback>
+void ForEachIntersection(Iterator1 first1, Iterator1 last1, Iterator2 first2, Iterator2 last2, Callback callback) {
+    while (first1 != last1 && first2 != last2) {
+        if (*first1 < *first2) {
+            first1 = GallopingLowerBound(first1, last1, *first2);
+        }
+        else if (*first2 < *first1) {
+            first2 = GallopingLowerBound(first2, last2, *first1);
+        }
+        else {
+            callback(first1, first2);
+            ++first1;
+            ++first2;
+        }
+    }
+}
@@ -0,0 +1,80 @@
+#include "stop_word_set.h"
+
+#include <algorithm>
+#include <cstring>
+
+StopWordSet::StopWordSet(const std::vector<std::string_view>& words) {
+    size_t capacity = 16;
+    while (capacity < words.size() * 2) {
+        capacity *= 2;
+    }
+    slots_.assign(capacity, Slot{ 0, 0, EMPTY_SLOT });
+    mask_ = capacity - 1;
+
+    for (const std::string_view word : words) {
+        if (word.empty()) {
+            continue;
+        }
+        const uint64_t prefix = LoadPrefix(word);
+        Slot& slot = slots_[FindSlot(word, prefix)];
+        if (slot.length != EMPTY_SLOT) {
+            continue;
+        }
+        slot = { prefix, static_cast<uint32_t>(chars_.size()), static_cast<uint32_t>(word.size()) };
+        chars_ += word;
+        length_mask_ |= LengthBit(word.size());
+        ++size_;
+    }
+}
+
+bool StopWordSet::Contains(std::string_view word) const {
+    if ((length_mask_ & LengthBit(word.size())) == 0) {
+        return false;
+    }
+    return slots_[FindSlot(word, LoadPrefix(word))].length != EMPTY_SLOT;
+}
+
+std::vector<std::string_view> StopWordSet::GetWords() const {
+    std::vector<std::string_view> words;
+    words.reserve(size_);
+    for (const Slot& slot : slots_) {
+        if (slot.length != EMPTY_SLOT) {
+            words.push_back(std::string_view(chars_).substr(slot.offset, slot.length));
+        }
+    }
+    return words;
+}
+
+size_t StopWordSet::size() const {
+    return size_;
+}
+
+size_t StopWordSet::GetMemoryBytes() const {
+    return chars_.capacity() + slots_.capacity() * sizeof(Slot);
+}
+
+//Ячейка со словом или пустая ячейка, где оно было бы.
+size_t StopWordSet::FindSlot(std::string_view word, uint64_t prefix) const {
+    const uint64_t hash = (prefix ^ (word.size() * 0x9e3779b97f4a7c15ULL)) * 0xff51afd7ed558ccdULL;
+    for (size_t index = static_cast<size_t>(hash >> 32) & mask_;; index = (index + 1) & mask_) {
+        const Slot& slot = slots_[index];
+        if (slot.length == EMPTY_SLOT) {
+            return index;
+        }
+        if (slot.prefix == prefix && slot.length == word.size()
+            && (word.size() <= sizeof(uint64_t)
+                || std::memcmp(chars_.data() + slot.offset + sizeof(uint64_t), word.data() + sizeof(uint64_t), word.size() - sizeof(uint64_t)) == 0)) {
+            return index;
+        }
+    }
+}
+
+uint64_t StopWordSet::LoadPrefix(std::string_view word) {
+    uint64_t prefix = 0;
+    std::memcpy(&prefix, word.data(), std::min(word.size(), sizeof(prefix)));
+    return prefix;
+}
+
+uint64_t StopWordSet::LengthBit(size_t length) {
+    return uint64_t{ 1 } << std::min<size_t>(length, 63);
+}
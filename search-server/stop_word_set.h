@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//Неизменяемое множество стоп-слов для быстрой проверки токенов.
+//Открытая адресация по хэшу длины и первых 8 байт слова; эти 8 байт лежат
+//в самой ячейке и сравниваются одним словом, к остальным байтам слова
+//обращение только при совпадении. Маска длин отсекает большинство токенов
+//ещё до хэша. Таблица заполнена не больше чем наполовину.
+class StopWordSet {
+public:
+    StopWordSet() = default;
+
+    //Повторы и пустые слова пропускаются.
+    explicit StopWordSet(const std::vector<std::string_view>& words);
+
+    bool Contains(std::string_view word) const;
+
+    //Слова множества в порядке ячеек таблицы.
+    std::vector<std::string_view> GetWords() const;
+
+    size_t size() const;
+
+    size_t GetMemoryBytes() const;
+
+private:
+    struct Slot {
+        uint64_t prefix;
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    static constexpr uint32_t EMPTY_SLOT = UINT32_MAX;
+
+    std::string chars_; //Все слова подряд.
+    std::vector<Slot> slots_;
+    uint64_t length_mask_ = 0; //Бит min(длина, 63) - есть слово такой длины.
+    size_t mask_ = 0;
+    size_t size_ = 0;
+
+    size_t FindSlot(std::string_view word, uint64_t prefix) const;
+
+    static uint64_t LoadPrefix(std::string_view word);
+
+    static uint64_t LengthBit(size_t length);
+};
@@ -0,0 +1,321 @@
+//Проверки поискового сервера, отдельная программа рядом с main.cpp.
+//Сборка из каталога search-server:
+//    g++ -std=c++17 -O2 -I. tests/tests.cpp $(ls *.cpp | grep -v main.cpp) -o tests -ltbb -lpthread
+//Запуск: ./tests [проверка ...], без аргументов - все проверки по очереди.
+//Ненулевой код возврата - какая-то проверка не прошла.
+
+#include <algorithm>
+#include <cmath>
+#include <execution>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document_filters.h"
+#include "numa_execution.h"
+#include "search_server.h"
+
+using namespace std::string_literals;
+
+namespace {
+
+void Check(bool condition, const std::string& message) {
+    if (!condition) {
+        throw std::logic_error(message);
+    }
+}
+
+template <typename Exception, typename Function>
+void CheckThrows(Function function, const std::string& message) {
+    try {
+        function();
+    }
+    catch (const Exception&) {
+        return;
+    }
+    throw std::logic_error(message);
+}
+
+std::vector<int> GetIds(const std::vector<Document>& documents) {
+    std::vector<int> ids;
+    for (const Document& document : documents) {
+        ids.push_back(document.id);
+    }
+    return ids;
+}
+
+void CheckSameDocuments(const std::vector<Document>& expected, const std::vector<Document>& actual, const std::string& message) {
+    const bool is_same = expected.size() == actual.size()
+        && std::equal(expected.begin(), expected.end(), actual.begin(), [](const Document& lhs, const Document& rhs) {
+            return lhs.id == rhs.id && lhs.rating == rhs.rating && std::abs(lhs.relevance - rhs.relevance) < 1e-9;
+        });
+    Check(is_same, message);
+}
+
+//Документы с рейтингом от 0 до 2: одинаковых релевантностей и рейтингов много,
+//порядок среди них задаёт только id.
+void AddTieDocuments(SearchServer& search_server) {
+    for (int id = 0; id < 60; ++id) {
+        const std::string text = "cat "s + (id % 3 == 0 ? "dog"s : "bird"s) + (id % 5 == 0 ? " cat"s : ""s);
+        search_server.AddDocument(id, text, DocumentStatus::ACTUAL, { id % 3 });
+    }
+}
+
+//Расширенный синтаксис включается явно; +слово*, группы ИЛИ и MatchDocument.
+void TestAdvancedQueries() {
+    SearchServer search_server(""s);
+    search_server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "dog +cat"s, DocumentStatus::ACTUAL, { 2 });
+    search_server.AddDocument(3, "catfish bird"s, DocumentStatus::ACTUAL, { 3 });
+    search_server.AddDocument(4, "bird"s, DocumentStatus::ACTUAL, { 4 });
+
+    std::vector<int> ids = GetIds(search_server.FindTopDocuments("+cat bird"s));
+    std::sort(ids.begin(), ids.end());
+    Check(ids == std::vector<int>{ 2, 3, 4 }, "without EnableAdvancedQuerySyntax +cat is a plain word"s);
+
+    const uint64_t generation = search_server.GetGeneration();
+    search_server.EnableAdvancedQuerySyntax();
+    Check(search_server.GetGeneration() != generation, "EnableAdvancedQuerySyntax changes the generation"s);
+
+    Check(GetIds(search_server.FindTopDocuments("+cat dog"s)) == std::vector<int>{ 1 }, "+cat requires cat"s);
+    Check(GetIds(search_server.FindTopDocuments("+cat* bird"s)) == std::vector<int>{ 3, 1 }, "+cat* requires a word starting with cat"s);
+    Check(search_server.FindTopDocuments("+zz* bird"s).empty(), "+prefix* without words matches nothing"s);
+
+    ids = GetIds(search_server.FindTopDocuments("catf*|dog"s));
+    std::sort(ids.begin(), ids.end());
+    Check(ids == std::vector<int>{ 1, 2, 3 }, "a group matches any of its words"s);
+
+    const auto [matched_words, status] = search_server.MatchDocument("+cat* bird"s, 3);
+    Check(matched_words.size() == 2 && status == DocumentStatus::ACTUAL, "MatchDocument returns the words of a matching document"s);
+    Check(std::get<0>(search_server.MatchDocument("+cat* bird"s, 4)).empty(), "MatchDocument returns nothing when +cat* fails"s);
+}
+
+//Буфер документа живёт, пока в нём есть документы, и слова словаря его переживают.
+void TestSharedBufferLifetime() {
+    SearchServer search_server("in"s);
+    auto text = std::make_shared<std::string>("white cat in the city"s);
+    const std::weak_ptr<std::string> observer = text;
+    search_server.AddDocument(1, *text, text, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "black cat"s, DocumentStatus::ACTUAL, { 2 });
+    text.reset();
+    Check(!observer.expired(), "the server keeps the buffer of a live document"s);
+    Check(GetIds(search_server.FindTopDocuments("white"s)) == std::vector<int>{ 1 }, "words are read from the buffer"s);
+
+    search_server.RemoveDocument(1);
+    Check(observer.expired(), "the buffer is released with its last document"s);
+    Check(GetIds(search_server.FindTopDocuments("cat"s)) == std::vector<int>{ 2 }, "a word anchored in the buffer survives it"s);
+    std::vector<std::string_view> words;
+    for (const auto& [word, frequency] : search_server.GetWordFrequencies(2)) {
+        words.push_back(word);
+    }
+    Check(words == std::vector<std::string_view>{ "black"sv, "cat"sv }, "word frequencies survive the buffer"s);
+}
+
+//seq, par, adaptive и numa дают одну выдачу, равные документы - по возрастанию id.
+void TestExecutionPolicies() {
+    SearchServer search_server("and"s);
+    AddTieDocuments(search_server);
+    const ExecutionThresholds thresholds = GetExecutionThresholds();
+    SetExecutionThresholds({ 0, 0 });
+    PinnedWorkerPool pool({ { 0, { 0, 0 } } });
+    for (const std::string& query : { "cat"s, "cat dog"s, "bird -dog"s, "dog bird cat"s }) {
+        const std::vector<Document> expected = search_server.FindTopDocuments<20>(std::execution::seq, query, AnyDocument{});
+        for (size_t i = 1; i < expected.size(); ++i) {
+            const bool is_tie = std::abs(expected[i - 1].relevance - expected[i].relevance) < EPSILON && expected[i - 1].rating == expected[i].rating;
+            Check(!is_tie || expected[i - 1].id < expected[i].id, "ties are ordered by id: "s + query);
+        }
+        CheckSameDocuments(expected, search_server.FindTopDocuments<20>(std::execution::par, query, AnyDocument{}), "par: "s + query);
+        CheckSameDocuments(expected, search_server.FindTopDocuments<20>(adaptive_execution, query, AnyDocument{}), "adaptive: "s + query);
+        CheckSameDocuments(expected, search_server.FindTopDocuments<20>(NumaExecutionPolicy{ &pool }, query, AnyDocument{}), "numa: "s + query);
+    }
+    SetExecutionThresholds(thresholds);
+}
+
+//Страницы по курсору и по номеру складываются в ту же выдачу без повторов и пропусков.
+void TestPaging() {
+    SearchServer search_server("and"s);
+    AddTieDocuments(search_server);
+    for (const std::string& query : { "cat"s, "cat dog"s, "bird -dog"s }) {
+        const std::vector<Document> expected = search_server.FindTopDocuments<100>(query, AnyDocument{});
+        std::vector<Document> by_cursor;
+        std::optional<SearchCursor> cursor;
+        do {
+            SearchPage page = search_server.FindDocumentsAfter(query, cursor, 7, AnyDocument{});
+            Check(page.documents.size() <= 7, "a page is not longer than page_size"s);
+            by_cursor.insert(by_cursor.end(), page.documents.begin(), page.documents.end());
+            cursor = page.next;
+        } while (cursor);
+        CheckSameDocuments(expected, by_cursor, "cursor pages: "s + query);
+
+        std::vector<Document> by_number;
+        for (size_t page = 0;; ++page) {
+            const std::vector<Document> documents = search_server.FindDocumentsPage(query, page, 7, AnyDocument{});
+            if (documents.empty()) {
+                break;
+            }
+            by_number.insert(by_number.end(), documents.begin(), documents.end());
+        }
+        CheckSameDocuments(expected, by_number, "numbered pages: "s + query);
+    }
+    CheckThrows<std::invalid_argument>([&search_server] {
+        search_server.FindDocumentsAfter("cat"s, std::nullopt, 0);
+    }, "page_size 0 is rejected"s);
+}
+
+//Rebuild не меняет выдачу; новые стоп-слова дают тот же индекс, что и с самого начала.
+void TestRebuild() {
+    SearchServer search_server("and"s);
+    AddTieDocuments(search_server);
+    for (int id = 0; id < 60; id += 4) {
+        search_server.RemoveDocument(id);
+    }
+    const std::vector<std::string> queries = { "cat"s, "cat dog"s, "bird -dog"s };
+    std::vector<std::vector<Document>> expected;
+    for (const std::string& query : queries) {
+        expected.push_back(search_server.FindTopDocuments<100>(query, AnyDocument{}));
+    }
+    search_server.Rebuild();
+    search_server.Rebuild(std::execution::par);
+    for (size_t query = 0; query < queries.size(); ++query) {
+        CheckSameDocuments(expected[query], search_server.FindTopDocuments<100>(queries[query], AnyDocument{}), "Rebuild: "s + queries[query]);
+    }
+
+    SearchServer with_stop_words("and the"s);
+    SearchServer extended("and"s);
+    for (SearchServer* server : { &with_stop_words, &extended }) {
+        server->AddDocument(1, "the cat and the dog"s, DocumentStatus::ACTUAL, { 1 });
+        server->AddDocument(2, "the bird"s, DocumentStatus::ACTUAL, { 2 });
+        server->AddDocument(3, "cat bird cat"s, DocumentStatus::ACTUAL, { 3 });
+    }
+    extended.Rebuild(std::execution::seq, std::vector<std::string>{ "and"s, "the"s });
+    for (const std::string& query : { "cat"s, "bird"s, "the dog"s }) {
+        CheckSameDocuments(with_stop_words.FindTopDocuments(query), extended.FindTopDocuments(query), "new stop words: "s + query);
+    }
+    Check(extended.GetWordFrequencies(2).size() == 1, "a new stop word leaves the forward index"s);
+    Check(extended.FindTopDocuments("the"s).empty(), "a new stop word is ignored in queries"s);
+    CheckThrows<std::invalid_argument>([&extended] {
+        extended.Rebuild(std::execution::seq, std::vector<std::string>{ "the"s });
+    }, "a stop word cannot be removed"s);
+    Check(extended.FindTopDocuments("the"s).empty(), "a rejected Rebuild keeps the stop words"s);
+}
+
+//Слово с * находит документы всех слов с этим префиксом, а для широкого
+//префикса - лучших, причём выбор обновляется после изменения индекса.
+void TestPrefixQueries() {
+    SearchServer search_server(""s);
+    search_server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "catalog"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(3, "dog"s, DocumentStatus::ACTUAL, { 1 });
+    std::vector<int> ids = GetIds(search_server.FindTopDocuments("cat*"s));
+    std::sort(ids.begin(), ids.end());
+    Check(ids == std::vector<int>{ 1, 2 }, "cat* matches cat and catalog"s);
+    Check(search_server.FindTopDocuments("cat* -catalog"s).size() == 1, "minus words apply to prefix matches"s);
+
+    SearchServer wide(""s);
+    for (int id = 0; id < 400; ++id) {
+        wide.AddDocument(id, "p"s + std::to_string(id % 200) + " p"s + std::to_string(id * 7 % 200) + " q"s, DocumentStatus::ACTUAL, { 1 });
+    }
+    const std::vector<Document> first = wide.FindTopDocuments("p*"s, AnyDocument{});
+    Check(!first.empty(), "a wide prefix finds documents"s);
+    CheckSameDocuments(first, wide.FindTopDocuments("p*"s, AnyDocument{}), "a repeated wide prefix gives the same result"s);
+    wide.AddDocument(1000, "pnew pnew"s, DocumentStatus::ACTUAL, { 1 });
+    Check(wide.FindTopDocuments("p*"s, AnyDocument{}).front().id == 1000, "the best terms of a prefix follow index changes"s);
+}
+
+//Холодные списки дают ту же выдачу, а изменение слова возвращает список в память.
+void TestColdTier() {
+    SearchServer search_server("and"s);
+    AddTieDocuments(search_server);
+    const std::vector<std::string> queries = { "cat"s, "cat dog"s, "bird -dog"s };
+    std::vector<std::vector<Document>> expected;
+    for (const std::string& query : queries) {
+        expected.push_back(search_server.FindTopDocuments<100>(query, AnyDocument{}));
+    }
+    Check(!search_server.GetColdPostingStats(), "no cold stats before MovePostingsToDisk"s);
+
+    const std::string path = (std::filesystem::temp_directory_path() / "search_server_tests_cold.bin").string();
+    search_server.MovePostingsToDisk(path, { 0, 0 });
+    Check(search_server.GetColdPostingStats()->cold_terms > 0, "resident_bytes 0 moves the lists to disk"s);
+    for (size_t query = 0; query < queries.size(); ++query) {
+        CheckSameDocuments(expected[query], search_server.FindTopDocuments<100>(queries[query], AnyDocument{}), "cold: "s + queries[query]);
+        CheckSameDocuments(expected[query], search_server.FindTopDocuments<100>(std::execution::par, queries[query], AnyDocument{}), "cold par: "s + queries[query]);
+    }
+
+    search_server.AddDocument(100, "dog dog"s, DocumentStatus::ACTUAL, { 9 });
+    search_server.RemoveDocument(3);
+    Check(search_server.FindTopDocuments("dog"s).front().id == 100, "a cold list takes new documents"s);
+    const std::vector<int> ids = GetIds(search_server.FindTopDocuments<100>("dog"s, AnyDocument{}));
+    Check(std::find(ids.begin(), ids.end(), 3) == ids.end(), "a cold list drops removed documents"s);
+}
+
+//Шарды узлов NUMA дают ту же выдачу, что и seq, в том числе после изменений
+//индекса и с холодными списками. Два узла изображаются одним процессором.
+void TestNumaShards() {
+    SearchServer search_server("and"s);
+    AddTieDocuments(search_server);
+    const ExecutionThresholds thresholds = GetExecutionThresholds();
+    SetExecutionThresholds({ 0, 0 });
+    PinnedWorkerPool pool({ { 0, { 0, 0 } }, { 1, { 0 } } });
+    const NumaExecutionPolicy policy{ &pool };
+    const std::vector<std::string> queries = { "cat"s, "cat dog"s, "bird -dog"s };
+    const auto check_queries = [&](const std::string& stage) {
+        for (const std::string& query : queries) {
+            CheckSameDocuments(search_server.FindTopDocuments<100>(std::execution::seq, query, AnyDocument{}),
+                search_server.FindTopDocuments<100>(policy, query, AnyDocument{}), stage + ": "s + query);
+            CheckSameDocuments(search_server.FindTopDocuments<3>(std::execution::seq, query, RatingBetween{ 1, 2 }),
+                search_server.FindTopDocuments<3>(policy, query, RatingBetween{ 1, 2 }), stage + " top 3: "s + query);
+        }
+    };
+    check_queries("shards"s);
+    Check(search_server.GetMemoryStats().numa_shard_bytes > 0, "shards are counted in GetMemoryStats"s);
+
+    search_server.AddDocument(100, "dog dog"s, DocumentStatus::ACTUAL, { 2 });
+    search_server.RemoveDocument(5);
+    check_queries("after changes"s);
+
+    search_server.MovePostingsToDisk((std::filesystem::temp_directory_path() / "search_server_tests_numa.bin").string(), { 0, 0 });
+    check_queries("cold"s);
+    SetExecutionThresholds(thresholds);
+}
+
+struct Test {
+    std::string name;
+    std::function<void()> run;
+};
+
+const std::vector<Test> TESTS = {
+    { "advanced_queries"s, TestAdvancedQueries },
+    { "shared_buffer"s, TestSharedBufferLifetime },
+    { "execution_policies"s, TestExecutionPolicies },
+    { "paging"s, TestPaging },
+    { "rebuild"s, TestRebuild },
+    { "prefix_queries"s, TestPrefixQueries },
+    { "cold_tier"s, TestColdTier },
+    { "numa_shards"s, TestNumaShards },
+};
+
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> names(argv + 1, argv + argc);
+    int failed = 0;
+    for (const Test& test : TESTS) {
+        if (names.empty() || std::find(names.begin(), names.end(), test.name) != names.end()) {
+            try {
+                test.run();
+                std::cerr << test.name << ": OK"s << std::endl;
+            }
+            catch (const std::exception& error) {
+                std::cerr << test.name << " failed: "s << error.what() << std::endl;
+                ++failed;
+            }
+        }
+    }
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+//Представление частот слов документа поверх прямого индекса SearchServer.
+//Слова перечисляются по алфавиту, как в прежнем map, по перестановке позиций
+//слов, которую SearchServer строит при добавлении документа. Ничего не
+//копируется и не сортируется. Действительно до следующего изменения SearchServer.
+class WordFrequencies {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<std::string_view, double>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        Iterator() = default;
+
+        Iterator(const uint32_t* position, const int* terms, const double* freqs, const std::vector<std::string_view>* words)
+            :position_(position), terms_(terms), freqs_(freqs), words_(words)
+        {}
+
+        value_type operator*() const {
+            return { (*words_)[terms_[*position_]], freqs_[*position_] };
+        }
+
+        Iterator& operator++() {
+            ++position_;
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return position_ == other.position_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return position_ != other.position_;
+        }
+
+    private:
+        const uint32_t* position_ = nullptr;
+        const int* terms_ = nullptr;
+        const double* freqs_ = nullptr;
+        const std::vector<std::string_view>* words_ = nullptr;
+    };
+
+    WordFrequencies() = default;
+
+    WordFrequencies(const int* terms_begin, const double* freqs_begin, const uint32_t* order_begin, size_t size, const std::vector<std::string_view>& terms)
+        :terms_begin_(terms_begin), freqs_begin_(freqs_begin), order_begin_(order_begin), size_(size), terms_(&terms)
+    {
+    }
+
+    Iterator begin() const {
+        return { order_begin_, terms_begin_, freqs_begin_, terms_ };
+    }
+
+    Iterator end() const {
+        return { order_begin_ + size_, terms_begin_, freqs_begin_, terms_ };
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    [[deprecated("iterate WordFrequencies directly")]]
+    operator std::map<std::string_view, double>() const {
+        std::map<std::string_view, double> result;
+        for (const auto [word, freq] : *this) {
+            result.emplace(word, freq);
+        }
+        return result;
+    }
+
+private:
+    const int* terms_begin_ = nullptr;
+    const double* freqs_begin_ = nullptr;
+    const uint32_t* order_begin_ = nullptr; //Позиции слов документа по алфавиту.
+    size_t size_ = 0;
+    const std::vector<std::string_view>* terms_ = nullptr;
+};